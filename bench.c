@@ -0,0 +1,250 @@
+/*
+ * bench.c
+ *
+ * Measures what the panel costs, and how long a status change takes to be drawn
+ *
+ * for the Raspberry Pi and other Linux systems
+ *
+ * Copyright 2019  rricharz
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ *
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <glib.h>
+
+#include "bench.h"
+
+struct histogram {
+  long bin[BENCH_BINS];			// the last bin also counts all longer latencies
+  long n;
+  double sum, max;			// in msec
+};
+
+struct bench {
+  FILE *out;
+  gint64 start;				// monotonic, in usec
+  struct rusage usage;			// at the start
+  long timer_events;
+  long drawn;
+  int composed;				// atomic, counted by the render thread
+  unsigned long seq;			// number of status records observed
+  int status, position;			// observed last
+  unsigned long record;			// sequence number of the record observed last
+  long skipped;				// records overwritten before they were observed
+  unsigned long pending_seq[BENCH_PENDING];
+  gint64 pending_published[BENCH_PENDING];	// monotonic, in usec
+  gint64 pending_observed[BENCH_PENDING];
+  int head, tail;
+  int queued;				// the record of this timer event is pending
+  long not_rendered;			// records whose timer event changed no view
+  long dropped;				// records never drawn, because too many were pending
+  struct histogram publish_observe;
+  struct histogram observe_present;
+  struct histogram latency;
+};
+
+static void hist_add(struct histogram *h, double msec)
+{
+	int k = msec < 0 ? 0 : msec >= BENCH_BINS - 1 ? BENCH_BINS - 1 : (int)msec;
+	h->bin[k]++;
+	h->n++;
+	h->sum += msec;
+	if (msec > h->max)
+		h->max = msec;
+}
+
+static double hist_percentile(const struct histogram *h, double p)
+// upper edge of the bin containing the percentile p, in msec, at most the maximum
+{
+	long need = (long)(p / 100.0 * h->n + 0.5);
+	long seen = 0;
+	for (int k = 0; k < BENCH_BINS; k++) {
+		seen += h->bin[k];
+		if ((seen >= need) && (seen > 0))
+			return k + 1 < h->max ? k + 1 : h->max;
+	}
+	return 0;
+}
+
+static void hist_write(FILE *f, const char *name, const struct histogram *h)
+// the percentiles, and the histogram in bins doubling in width
+{
+	fprintf(f, "%s_count %ld\n", name, h->n);
+	fprintf(f, "%s_mean_ms %.1f\n", name, h->n ? h->sum / h->n : 0.0);
+	fprintf(f, "%s_p50_ms %.0f\n", name, hist_percentile(h, 50));
+	fprintf(f, "%s_p90_ms %.0f\n", name, hist_percentile(h, 90));
+	fprintf(f, "%s_p99_ms %.0f\n", name, hist_percentile(h, 99));
+	fprintf(f, "%s_max_ms %.1f\n", name, h->max);
+	long n = 0;
+	for (int k = 0, edge = 1; k < BENCH_BINS; k++) {
+		n += h->bin[k];
+		if ((k + 1 == edge) || (k == BENCH_BINS - 1)) {
+			if (k == BENCH_BINS - 1)
+				fprintf(f, "%s_hist_ge_%dms %ld\n", name, edge / 2, n);
+			else
+				fprintf(f, "%s_hist_lt_%dms %ld\n", name, edge, n);
+			n = 0;
+			edge *= 2;
+		}
+	}
+}
+
+struct bench *bench_new(char *file)
+// the report is written to file when the panel quits, return 0 on failure
+{
+	struct bench *b = g_new0(struct bench, 1);
+
+	b->out = fopen(file, "w");
+	if (b->out == 0) {
+		printf("Cannot open %s\n", file);
+		g_free(b);
+		return 0;
+	}
+	b->status = -1;
+	b->start = g_get_monotonic_time();
+	getrusage(RUSAGE_SELF, &b->usage);
+	return b;
+}
+
+unsigned long bench_observe(struct bench *b, int status, int position, long long stamp,
+	unsigned long seq)
+// called on every timer event with the record read, returns the number of the
+// last record observed, to be passed on with the frames composed after it
+{
+	gint64 now = g_get_monotonic_time();
+	gint64 published;
+
+	b->timer_events++;
+	b->queued = 0;
+	if (b->status == -1) {
+		// the record written before the panel was started is not measured
+		b->status = status;
+		b->position = position;
+		b->record = seq;
+		return 0;
+	}
+	if (seq != 0) {
+		// the writer stamps its records, every record counts, even if nothing changed
+		if (seq == b->record)
+			return b->seq;
+		if (seq > b->record + 1)
+			b->skipped += seq - b->record - 1;
+		b->record = seq;
+		published = stamp;
+	}
+	else {
+		// only changes can be seen, at the modification time of the file
+		if ((status == b->status) && (position == b->position))
+			return b->seq;
+		struct stat st;
+		published = now;
+		if (stat("/tmp/tu56status", &st) == 0)
+			published = (gint64)st.st_mtim.tv_sec * G_USEC_PER_SEC + st.st_mtim.tv_nsec / 1000
+				- g_get_real_time() + now;
+	}
+	b->status = status;
+	b->position = position;
+	b->seq++;
+
+	hist_add(&b->publish_observe, (now - published) / 1000.0);
+	if ((b->head + 1) % BENCH_PENDING == b->tail) {
+		b->tail = (b->tail + 1) % BENCH_PENDING;
+		b->dropped++;
+	}
+	b->pending_seq[b->head] = b->seq;
+	b->pending_published[b->head] = published;
+	b->pending_observed[b->head] = now;
+	b->head = (b->head + 1) % BENCH_PENDING;
+	b->queued = 1;
+	return b->seq;
+}
+
+void bench_rendered(struct bench *b, int damaged)
+// called on every timer event after bench_observe, damaged if a view is drawn again,
+// otherwise no frame will show the record read and it is not timed further
+{
+	if (b->queued && !damaged && (b->head != b->tail)) {
+		b->head = (b->head - 1 + BENCH_PENDING) % BENCH_PENDING;
+		b->not_rendered++;
+	}
+	b->queued = 0;
+}
+
+void bench_composed(struct bench *b)
+// called by the render thread for every frame
+{
+	g_atomic_int_inc(&b->composed);
+}
+
+void bench_drawn(struct bench *b, unsigned long seq)
+// called when a frame is drawn, which was composed after the record seq was observed
+{
+	gint64 now = g_get_monotonic_time();
+
+	b->drawn++;
+	while ((b->tail != b->head) && (b->pending_seq[b->tail] <= seq)) {
+		hist_add(&b->observe_present, (now - b->pending_observed[b->tail]) / 1000.0);
+		hist_add(&b->latency, (now - b->pending_published[b->tail]) / 1000.0);
+		b->tail = (b->tail + 1) % BENCH_PENDING;
+	}
+}
+
+static double seconds(struct timeval tv)
+{
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+void bench_free(struct bench *b)
+// writes the report
+{
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+	double t = (g_get_monotonic_time() - b->start) / 1e6;
+	double user = seconds(ru.ru_utime) - seconds(b->usage.ru_utime);
+	double system = seconds(ru.ru_stime) - seconds(b->usage.ru_stime);
+	long voluntary = ru.ru_nvcsw - b->usage.ru_nvcsw;
+	long involuntary = ru.ru_nivcsw - b->usage.ru_nivcsw;
+
+	fprintf(b->out, "seconds %.1f\n", t);
+	fprintf(b->out, "cpu_user_s %.2f\n", user);
+	fprintf(b->out, "cpu_system_s %.2f\n", system);
+	fprintf(b->out, "cpu_percent %.1f\n", 100.0 * (user + system) / t);
+	fprintf(b->out, "voluntary_switches %ld\n", voluntary);
+	fprintf(b->out, "involuntary_switches %ld\n", involuntary);
+	// every thread which blocks and is woken up again switches voluntarily
+	fprintf(b->out, "wakeups_per_s %.1f\n", voluntary / t);
+	fprintf(b->out, "timer_events_per_s %.1f\n", b->timer_events / t);
+	fprintf(b->out, "frames_composed_per_s %.1f\n", g_atomic_int_get(&b->composed) / t);
+	fprintf(b->out, "frames_drawn_per_s %.1f\n", b->drawn / t);
+	fprintf(b->out, "status_records %lu\n", b->seq);
+	fprintf(b->out, "status_records_not_rendered %ld\n", b->not_rendered);
+	fprintf(b->out, "status_records_not_drawn %ld\n",
+		b->dropped + (b->head - b->tail + BENCH_PENDING) % BENCH_PENDING);
+	fprintf(b->out, "status_records_not_observed %ld\n", b->skipped);
+	hist_write(b->out, "publish_observe", &b->publish_observe);
+	hist_write(b->out, "observe_present", &b->observe_present);
+	hist_write(b->out, "latency", &b->latency);
+	fclose(b->out);
+	g_free(b);
+}
@@ -0,0 +1,60 @@
+/*
+ * bench.h
+ *
+ * Measures what the panel costs, and how long a status change takes to be drawn
+ *
+ * for the Raspberry Pi and other Linux systems
+ *
+ * Copyright 2019  rricharz
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ *
+ */
+
+
+#ifndef BENCH_H
+#define BENCH_H
+
+// With -bench file, the panel counts its timer events and frames, and measures for
+// every status record observed:
+//
+//   publish_observe	from writing the record to reading it on a timer event
+//   observe_present	from reading it to the first frame drawn after it was read
+//   latency		from writing the record to the frame drawn, the sum of both
+//
+// Only the records read on a timer event which changes a view wait for a frame.
+// The others, a drive which stays at rest for example, are counted separately.
+//
+// The record is timed by its time stamp, see tape.h, or by the modification time
+// of the status file if the writer does not add one. When the panel quits, the CPU
+// time and the context switches of the process are added, and everything is written
+// to the file as "name value" lines, which bench.sh compares across runs.
+
+#define BENCH_BINS		2000		// latency histogram, one bin per msec
+#define BENCH_PENDING		256		// changes observed but not yet drawn
+
+struct bench;
+
+struct bench *bench_new(char *file);
+unsigned long bench_observe(struct bench *b, int status, int position, long long stamp,
+	unsigned long seq);
+void bench_rendered(struct bench *b, int damaged);
+void bench_composed(struct bench *b);
+void bench_drawn(struct bench *b, unsigned long seq);
+void bench_free(struct bench *b);
+
+#endif
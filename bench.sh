@@ -0,0 +1,115 @@
+#!/bin/sh
+#
+# bench.sh
+#
+# Measures what a panel costs while a tape workload runs, and how long the status
+# changes take to be drawn. The report can be compared with the report of another commit.
+#
+# usage: ./bench.sh [-panel tu77] [-seconds n] [-pattern name | -replay log] [-xvfb]
+#                   [-o report] [panel options and drives ...]
+#        ./bench.sh -compare report1 report2
+#
+# The workload is written by demo -pattern name, stream by default, or replayed
+# from a TQ debug log of SimH with tqreplay. The panel runs on the display, or under
+# Xvfb with -xvfb or without a display. It measures itself with -bench, see bench.h.
+#
+# for the Raspberry Pi and other Linux systems
+#
+# Copyright 2019  rricharz
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+# MA 02110-1301, USA.
+#
+
+if [ "$1" = "-compare" ]; then
+	if [ $# -ne 3 ]; then
+		echo "usage: ./bench.sh -compare report1 report2"
+		exit 1
+	fi
+	# the values of both reports side by side, with the change of the numbers in percent
+	awk 'NR == FNR { a[$1] = substr($0, length($1) + 2); next }
+		{ b = substr($0, length($1) + 2)
+		  if (b !~ /^[0-9.]+$/) {
+			printf "%-30s %s | %s\n", $1, a[$1], b
+			next
+		  }
+		  printf "%-30s %12s %12s", $1, a[$1], b
+		  if (($1 in a) && (a[$1] + 0 != 0))
+			printf " %+8.1f%%", 100 * (b - a[$1]) / a[$1]
+		  printf "\n" }' "$2" "$3"
+	exit 0
+fi
+
+panel=tu77
+seconds=30
+pattern=stream
+replay=
+xvfb=
+report=bench-report.txt
+
+while [ $# -gt 0 ]; do
+	case "$1" in
+	-panel)		panel="$2"; shift ;;
+	-seconds)	seconds="$2"; shift ;;
+	-pattern)	pattern="$2"; shift ;;
+	-replay)	replay="$2"; shift ;;
+	-xvfb)		xvfb=1 ;;
+	-o)		report="$2"; shift ;;
+	*)		break ;;
+	esac
+	shift
+done
+
+if [ -z "$DISPLAY" ]; then
+	xvfb=1
+fi
+if [ -n "$xvfb" ]; then
+	Xvfb :77 -screen 0 1920x1080x24 >/dev/null 2>&1 &
+	xvfbpid=$!
+	export DISPLAY=:77
+	sleep 1
+fi
+
+measured=$(mktemp)
+printf "%c0\n" " " > /tmp/tu56status
+
+./$panel -bench "$measured" "$@" >/dev/null &
+panelpid=$!
+sleep 3					# the startup is not part of the workload
+
+if [ -n "$replay" ]; then
+	workload="replay $(basename "$replay")"
+	timeout "$seconds" ./tqreplay "$replay" >/dev/null
+else
+	workload="demo -pattern $pattern"
+	timeout "$seconds" ./demo -pattern "$pattern" >/dev/null
+fi
+sleep 1					# the last changes are drawn
+
+kill -TERM $panelpid
+wait $panelpid
+if [ -n "$xvfbpid" ]; then
+	kill $xvfbpid
+fi
+
+{
+	echo "commit $(git describe --always --dirty 2>/dev/null)"
+	echo "panel $panel $*"
+	echo "workload $workload"
+	if [ -n "$xvfb" ]; then echo "display Xvfb"; else echo "display $DISPLAY"; fi
+	cat "$measured"
+} > "$report"
+rm -f "$measured"
+cat "$report"
@@ -0,0 +1,522 @@
+/*
+ * blit.c
+ *
+ * Composition of pre-scaled sprites at integer positions
+ *
+ * Opaque spans are copied, translucent spans are blended with
+ * NEON, AVX2 or SSE2 kernels where available
+ *
+ * for the Raspberry Pi and other Linux systems
+ *
+ * Copyright 2019  rricharz
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define BLIT_NEON
+#include <arm_neon.h>
+#elif defined(__x86_64__) || defined(__SSE2__)
+#define BLIT_SSE2
+#include <immintrin.h>
+#endif
+
+#include "blit.h"
+
+static inline uint32_t over(uint32_t s, uint32_t d)
+// premultiplied s over d, (x + 128 + ((x + 128) >> 8)) >> 8 is x / 255 rounded
+{
+	uint32_t ia = 255 - (s >> 24);
+	uint32_t rb = (d & 0x00ff00ff) * ia + 0x00800080;
+	rb = ((rb + ((rb >> 8) & 0x00ff00ff)) >> 8) & 0x00ff00ff;
+	uint32_t ag = ((d >> 8) & 0x00ff00ff) * ia + 0x00800080;
+	ag = (ag + ((ag >> 8) & 0x00ff00ff)) & 0xff00ff00;
+	return s + (rb | ag);
+}
+
+#ifdef BLIT_NEON
+
+static int blend_neon(uint32_t *dst, const uint32_t *src, int n)
+// blend 8 pixels at a time, return the number of pixels done
+{
+	int i;
+	for (i = 0; i + 8 <= n; i += 8) {
+		uint8x8x4_t s = vld4_u8((const uint8_t *)(src + i));
+		uint8x8x4_t d = vld4_u8((const uint8_t *)(dst + i));
+		uint8x8_t ia = vmvn_u8(s.val[3]);
+		for (int c = 0; c < 4; c++) {
+			uint16x8_t t = vaddq_u16(vmull_u8(d.val[c], ia), vdupq_n_u16(128));
+			d.val[c] = vadd_u8(s.val[c], vshrn_n_u16(vsraq_n_u16(t, t, 8), 8));
+		}
+		vst4_u8((uint8_t *)(dst + i), d);
+	}
+	return i;
+}
+
+#endif
+
+#ifdef BLIT_SSE2
+
+static inline __m128i blend4_sse2(__m128i s, __m128i d)
+{
+	__m128i zero = _mm_setzero_si128();
+	__m128i c128 = _mm_set1_epi16(128);
+	__m128i ia = _mm_sub_epi32(_mm_set1_epi32(255), _mm_srli_epi32(s, 24));
+	ia = _mm_or_si128(ia, _mm_slli_epi32(ia, 16));
+	__m128i lo = _mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi32(ia, ia));
+	__m128i hi = _mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi32(ia, ia));
+	lo = _mm_add_epi16(lo, c128);
+	hi = _mm_add_epi16(hi, c128);
+	lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+	hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+	return _mm_add_epi8(s, _mm_packus_epi16(lo, hi));
+}
+
+static int blend_sse2(uint32_t *dst, const uint32_t *src, int n)
+// blend 4 pixels at a time, return the number of pixels done
+{
+	int i;
+	for (i = 0; i + 4 <= n; i += 4) {
+		__m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+		__m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+		_mm_storeu_si128((__m128i *)(dst + i), blend4_sse2(s, d));
+	}
+	return i;
+}
+
+__attribute__((target("avx2")))
+static int blend_avx2(uint32_t *dst, const uint32_t *src, int n)
+// blend 8 pixels at a time, return the number of pixels done
+{
+	int i;
+	__m256i zero = _mm256_setzero_si256();
+	__m256i c128 = _mm256_set1_epi16(128);
+	for (i = 0; i + 8 <= n; i += 8) {
+		__m256i s = _mm256_loadu_si256((const __m256i *)(src + i));
+		__m256i d = _mm256_loadu_si256((const __m256i *)(dst + i));
+		__m256i ia = _mm256_sub_epi32(_mm256_set1_epi32(255), _mm256_srli_epi32(s, 24));
+		ia = _mm256_or_si256(ia, _mm256_slli_epi32(ia, 16));
+		__m256i lo = _mm256_mullo_epi16(_mm256_unpacklo_epi8(d, zero), _mm256_unpacklo_epi32(ia, ia));
+		__m256i hi = _mm256_mullo_epi16(_mm256_unpackhi_epi8(d, zero), _mm256_unpackhi_epi32(ia, ia));
+		lo = _mm256_add_epi16(lo, c128);
+		hi = _mm256_add_epi16(hi, c128);
+		lo = _mm256_srli_epi16(_mm256_add_epi16(lo, _mm256_srli_epi16(lo, 8)), 8);
+		hi = _mm256_srli_epi16(_mm256_add_epi16(hi, _mm256_srli_epi16(hi, 8)), 8);
+		_mm256_storeu_si256((__m256i *)(dst + i), _mm256_add_epi8(s, _mm256_packus_epi16(lo, hi)));
+	}
+	return i;
+}
+
+#endif
+
+static inline uint32_t mix(uint32_t a, uint32_t b, uint32_t w)
+// (256 - w) * a + w * b, w is 1 ... 255
+{
+	uint32_t rb = ((a & 0x00ff00ff) * (256 - w) + (b & 0x00ff00ff) * w) >> 8;
+	uint32_t ag = ((a >> 8) & 0x00ff00ff) * (256 - w) + ((b >> 8) & 0x00ff00ff) * w;
+	return (rb & 0x00ff00ff) | (ag & 0xff00ff00);
+}
+
+static void mix_span(uint32_t *dst, const uint32_t *a, const uint32_t *b, int w, int n)
+// cross-fade n pixels of a and b into dst
+{
+	int i = 0;
+#if defined(BLIT_NEON)
+	uint8x8_t wa = vdup_n_u8(256 - w), wb = vdup_n_u8(w);
+	for (; i + 8 <= n; i += 8) {
+		uint8x16_t pa = vld1q_u8((const uint8_t *)(a + i));
+		uint8x16_t pb = vld1q_u8((const uint8_t *)(b + i));
+		uint16x8_t lo = vmlal_u8(vmull_u8(vget_low_u8(pa), wa), vget_low_u8(pb), wb);
+		uint16x8_t hi = vmlal_u8(vmull_u8(vget_high_u8(pa), wa), vget_high_u8(pb), wb);
+		vst1q_u8((uint8_t *)(dst + i), vcombine_u8(vshrn_n_u16(lo, 8), vshrn_n_u16(hi, 8)));
+	}
+#elif defined(BLIT_SSE2)
+	__m128i zero = _mm_setzero_si128();
+	__m128i wa = _mm_set1_epi16(256 - w), wb = _mm_set1_epi16(w);
+	for (; i + 4 <= n; i += 4) {
+		__m128i pa = _mm_loadu_si128((const __m128i *)(a + i));
+		__m128i pb = _mm_loadu_si128((const __m128i *)(b + i));
+		__m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(pa, zero), wa),
+			_mm_mullo_epi16(_mm_unpacklo_epi8(pb, zero), wb));
+		__m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(pa, zero), wa),
+			_mm_mullo_epi16(_mm_unpackhi_epi8(pb, zero), wb));
+		_mm_storeu_si128((__m128i *)(dst + i),
+			_mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8)));
+	}
+#endif
+	for (; i < n; i++)
+		dst[i] = mix(a[i], b[i], w);
+}
+
+static void mix_span565(uint16_t *dst, uint8_t *alpha, const struct sprite *s0,
+	const struct sprite *s1, int w, int sx, int sy, int n)
+// cross-fade n pixels of two 16 bit sprites into dst and alpha
+{
+	const uint16_t *a = s0->data16 + sy * s0->stride + sx;
+	const uint16_t *b = s1->data16 + sy * s1->stride + sx;
+	for (int i = 0; i < n; i++) {
+		uint32_t r = ((a[i] >> 11) * (256 - w) + (b[i] >> 11) * w) >> 8;
+		uint32_t g = (((a[i] >> 5) & 63) * (256 - w) + ((b[i] >> 5) & 63) * w) >> 8;
+		uint32_t bl = ((a[i] & 31) * (256 - w) + (b[i] & 31) * w) >> 8;
+		dst[i] = (r << 11) | (g << 5) | bl;
+		uint32_t aa = s0->alpha ? s0->alpha[sy * s0->width + sx + i] : 255;
+		uint32_t ab = s1->alpha ? s1->alpha[sy * s1->width + sx + i] : 255;
+		alpha[i] = (aa * (256 - w) + ab * w) >> 8;
+	}
+}
+
+#if defined(BLIT_SSE2)
+static int avx2;				// set by blit_init, only read afterwards
+#endif
+
+void blit_init()
+// detect the CPU, before any thread composes
+{
+#if defined(BLIT_SSE2)
+	__builtin_cpu_init();
+	avx2 = __builtin_cpu_supports("avx2");
+#endif
+}
+
+void blend_span(uint32_t *dst, const uint32_t *src, int n)
+// blend n premultiplied pixels of src over dst
+{
+	int i = 0;
+#if defined(BLIT_NEON)
+	i = blend_neon(dst, src, n);
+#elif defined(BLIT_SSE2)
+	if (avx2)
+		i = blend_avx2(dst, src, n);
+	i += blend_sse2(dst + i, src + i, n - i);
+#endif
+	for (; i < n; i++)
+		dst[i] = over(src[i], dst[i]);
+}
+
+struct sprite *sprite_new(cairo_surface_t *surface)
+// make a sprite from a premultiplied ARGB32 image surface, the sprite owns the surface
+{
+	struct sprite *s = calloc(1, sizeof(struct sprite));
+	cairo_surface_flush(surface);
+	s->surface = surface;
+	s->format = CAIRO_FORMAT_ARGB32;
+	s->data = (uint32_t *)cairo_image_surface_get_data(surface);
+	s->stride = cairo_image_surface_get_stride(surface) / 4;
+	s->width = cairo_image_surface_get_width(surface);
+	s->height = cairo_image_surface_get_height(surface);
+	s->row = malloc((s->height + 1) * sizeof(int));
+
+	// the first pass counts the spans, the second pass records them
+	for (int pass = 0; pass < 2; pass++) {
+		int k = 0;
+		for (int y = 0; y < s->height; y++) {
+			const uint32_t *p = s->data + y * s->stride;
+			s->row[y] = k;
+			int x = 0;
+			while (x < s->width) {
+				int a = p[x] >> 24;
+				int start = x;
+				if (a == 0) {
+					while ((x < s->width) && ((p[x] >> 24) == 0)) x++;
+					continue;
+				}
+				if (a == 255)
+					while ((x < s->width) && ((p[x] >> 24) == 255)) x++;
+				else
+					while ((x < s->width) && ((p[x] >> 24) != 255) && ((p[x] >> 24) != 0)) x++;
+				if (pass) {
+					s->span[k].x = start;
+					s->span[k].n = x - start;
+					s->span[k].opaque = (a == 255);
+				}
+				k++;
+			}
+		}
+		s->row[s->height] = k;
+		if (pass == 0)
+			s->span = malloc((k + 1) * sizeof(struct span));
+	}
+
+	// the interior of a row is its longest opaque span
+	s->interior = calloc(s->height + 1, sizeof(struct span));
+	for (int y = 0; y < s->height; y++) {
+		for (int k = s->row[y]; k < s->row[y + 1]; k++) {
+			if (s->span[k].opaque && (s->span[k].n > s->interior[y].n))
+				s->interior[y] = s->span[k];
+		}
+	}
+	return s;
+}
+
+void sprite_reduce(struct sprite *s)
+// store an ARGB32 sprite as 16 bit colors and an 8 bit alpha mask
+{
+	if (s->format != CAIRO_FORMAT_ARGB32)
+		return;
+	cairo_surface_t *t = cairo_image_surface_create(CAIRO_FORMAT_RGB16_565, s->width, s->height);
+	uint16_t *d = (uint16_t *)cairo_image_surface_get_data(t);
+	int ds = cairo_image_surface_get_stride(t) / 2;
+	uint8_t *alpha = malloc(s->width * s->height);
+	int opaque = 1;
+
+	for (int y = 0; y < s->height; y++) {
+		for (int x = 0; x < s->width; x++) {
+			uint32_t p = s->data[y * s->stride + x];
+			d[y * ds + x] = ((p >> 8) & 0xf800) | ((p >> 5) & 0x07e0) | ((p >> 3) & 0x001f);
+			alpha[y * s->width + x] = p >> 24;
+			if ((p >> 24) != 255)
+				opaque = 0;
+		}
+	}
+	cairo_surface_mark_dirty(t);
+	if (opaque) {
+		free(alpha);
+		alpha = 0;
+	}
+	cairo_surface_destroy(s->surface);
+	s->surface = t;
+	s->format = CAIRO_FORMAT_RGB16_565;
+	s->data = 0;
+	s->data16 = d;
+	s->alpha = alpha;
+	s->stride = ds;
+}
+
+void sprite_free(struct sprite *s)
+{
+	if (s == 0)
+		return;
+	cairo_surface_destroy(s->surface);
+	free(s->alpha);
+	free(s->row);
+	free(s->span);
+	free(s->interior);
+	free(s);
+}
+
+void frame_init(struct frame *f, cairo_surface_t *surface)
+// describe a RGB24 or RGB16_565 image surface as a frame
+{
+	cairo_surface_flush(surface);
+	f->format = cairo_image_surface_get_format(surface);
+	f->width = cairo_image_surface_get_width(surface);
+	f->height = cairo_image_surface_get_height(surface);
+	if (f->format == CAIRO_FORMAT_RGB16_565) {
+		f->data = 0;
+		f->data16 = (uint16_t *)cairo_image_surface_get_data(surface);
+		f->stride = cairo_image_surface_get_stride(surface) / 2;
+	}
+	else {
+		f->data = (uint32_t *)cairo_image_surface_get_data(surface);
+		f->data16 = 0;
+		f->stride = cairo_image_surface_get_stride(surface) / 4;
+	}
+}
+
+static void blend565(uint16_t *dst, const uint16_t *src, const uint8_t *alpha, int n)
+// blend n premultiplied 16 bit pixels of src over dst
+{
+	for (int i = 0; i < n; i++) {
+		uint32_t ia = 255 - alpha[i];
+		uint32_t d = dst[i], s = src[i];
+		uint32_t r = (d >> 11) * ia + 128;
+		uint32_t g = ((d >> 5) & 63) * ia + 128;
+		uint32_t b = (d & 31) * ia + 128;
+		// the 16 bit colors are truncated, the sum can exceed the maximum by one
+		r = (s >> 11) + ((r + (r >> 8)) >> 8);
+		g = ((s >> 5) & 63) + ((g + (g >> 8)) >> 8);
+		b = (s & 31) + ((b + (b >> 8)) >> 8);
+		if (r > 31) r = 31;
+		if (g > 63) g = 63;
+		if (b > 31) b = 31;
+		dst[i] = (r << 11) | (g << 5) | b;
+	}
+}
+
+static inline void copy_pixels(struct frame *f, const struct sprite *s, int fx, int fy,
+	int sx, int sy, int n)
+// copy n pixels of sprite s starting at sx, sy to fx, fy in the frame
+{
+	if (f->format == CAIRO_FORMAT_RGB16_565)
+		memcpy(f->data16 + fy * f->stride + fx, s->data16 + sy * s->stride + sx, n * 2);
+	else
+		memcpy(f->data + fy * f->stride + fx, s->data + sy * s->stride + sx, n * 4);
+}
+
+static inline void blend_pixels(struct frame *f, const struct sprite *s, int fx, int fy,
+	int sx, int sy, int n)
+// blend n pixels of sprite s starting at sx, sy over fx, fy in the frame
+{
+	if (f->format == CAIRO_FORMAT_RGB16_565)
+		blend565(f->data16 + fy * f->stride + fx, s->data16 + sy * s->stride + sx,
+			s->alpha + sy * s->width + sx, n);
+	else
+		blend_span(f->data + fy * f->stride + fx, s->data + sy * s->stride + sx, n);
+}
+
+static int clip_sprite(const struct frame *f, const struct sprite *s, int x, int y,
+	const cairo_rectangle_int_t *clip, int *x0, int *y0, int *x1, int *y1)
+// compute the frame area covered by sprite s at x, y, return 0 if it is empty
+{
+	*x0 = x;
+	*y0 = y;
+	*x1 = x + s->width;
+	*y1 = y + s->height;
+	if (*x0 < 0) *x0 = 0;
+	if (*y0 < 0) *y0 = 0;
+	if (*x1 > f->width) *x1 = f->width;
+	if (*y1 > f->height) *y1 = f->height;
+	if (clip != 0) {
+		if (*x0 < clip->x) *x0 = clip->x;
+		if (*y0 < clip->y) *y0 = clip->y;
+		if (*x1 > clip->x + clip->width) *x1 = clip->x + clip->width;
+		if (*y1 > clip->y + clip->height) *y1 = clip->y + clip->height;
+	}
+	return (*x0 < *x1) && (*y0 < *y1);
+}
+
+void blit(struct frame *f, const struct sprite *s, int x, int y,
+	const cairo_rectangle_int_t *clip, int op)
+// compose sprite s with its top left corner at x, y into the frame
+// only pixels within the clip rectangle are changed, clip may be 0
+{
+	int x0, y0, x1, y1;
+	if (!clip_sprite(f, s, x, y, clip, &x0, &y0, &x1, &y1))
+		return;
+
+	for (int fy = y0; fy < y1; fy++) {
+		if (op == BLIT_SOURCE) {
+			copy_pixels(f, s, x0, fy, x0 - x, fy - y, x1 - x0);
+			continue;
+		}
+		const struct span *sp = s->span + s->row[fy - y];
+		const struct span *end = s->span + s->row[fy - y + 1];
+		for (; sp < end; sp++) {
+			int a = sp->x, b = sp->x + sp->n;
+			if (a < x0 - x) a = x0 - x;
+			if (b > x1 - x) b = x1 - x;
+			if (a >= b)
+				continue;
+			if (sp->opaque)
+				copy_pixels(f, s, x + a, fy, a, fy - y, b - a);
+			else
+				blend_pixels(f, s, x + a, fy, a, fy - y, b - a);
+		}
+	}
+}
+
+void blit_occluded(struct frame *f, const struct sprite *s, int x, int y,
+	const cairo_rectangle_int_t *clip, const struct occluder *o, int n)
+// copy sprite s into the frame like blit with BLIT_SOURCE, but skip the pixels
+// covered by the interiors of the n occluders, which are drawn later
+{
+	int x0, y0, x1, y1;
+	if (!clip_sprite(f, s, x, y, clip, &x0, &y0, &x1, &y1))
+		return;
+
+	for (int fy = y0; fy < y1; fy++) {
+		int a[n], b[n], k = 0;
+
+		// collect the covered intervals of this row, sorted by their left edge
+		for (int i = 0; i < n; i++) {
+			int oy = fy - o[i].y;
+			if ((oy < 0) || (oy >= o[i].sprite->height))
+				continue;
+			const struct span *in = &o[i].sprite->interior[oy];
+			int ia = in->x, ib = in->x + in->n;
+			if (o[i].mix != 0) {
+				const struct span *in2 = &o[i].mix->interior[oy];
+				if (ia < in2->x) ia = in2->x;
+				if (ib > in2->x + in2->n) ib = in2->x + in2->n;
+			}
+			if (ia >= ib)
+				continue;
+			int j = k++;
+			for (; (j > 0) && (a[j - 1] > o[i].x + ia); j--) {
+				a[j] = a[j - 1];
+				b[j] = b[j - 1];
+			}
+			a[j] = o[i].x + ia;
+			b[j] = o[i].x + ib;
+		}
+
+		// copy the gaps between them
+		int fx = x0;
+		for (int j = 0; (j < k) && (fx < x1); j++) {
+			if (a[j] > fx)
+				copy_pixels(f, s, fx, fy, fx - x, fy - y, (a[j] < x1 ? a[j] : x1) - fx);
+			if (b[j] > fx)
+				fx = b[j];
+		}
+		if (fx < x1)
+			copy_pixels(f, s, fx, fy, fx - x, fy - y, x1 - fx);
+	}
+}
+
+void blit_mix(struct frame *f, const struct sprite *s0, const struct sprite *s1, int w,
+	int x, int y, const cairo_rectangle_int_t *clip)
+// compose the cross-fade of two sprites of the same size over the frame,
+// with weight w / 256 for s1
+{
+	int x0, y0, x1, y1;
+	if (w <= 0) {
+		blit(f, s0, x, y, clip, BLIT_OVER);
+		return;
+	}
+	if (w >= 256) {
+		blit(f, s1, x, y, clip, BLIT_OVER);
+		return;
+	}
+	if (!clip_sprite(f, s0, x, y, clip, &x0, &y0, &x1, &y1))
+		return;
+
+	uint32_t row[x1 - x0];
+	uint16_t row16[x1 - x0];
+	uint8_t alpha[x1 - x0];
+	for (int fy = y0; fy < y1; fy++) {
+		int sy = fy - y;
+
+		// pixels outside the spans of both sprites are transparent
+		int a = s0->width, b = 0;
+		const struct sprite *s[2] = { s0, s1 };
+		for (int i = 0; i < 2; i++) {
+			if (s[i]->row[sy] == s[i]->row[sy + 1])
+				continue;
+			const struct span *first = &s[i]->span[s[i]->row[sy]];
+			const struct span *last = &s[i]->span[s[i]->row[sy + 1] - 1];
+			if (first->x < a) a = first->x;
+			if (last->x + last->n > b) b = last->x + last->n;
+		}
+		if (a < x0 - x) a = x0 - x;
+		if (b > x1 - x) b = x1 - x;
+		if (a >= b)
+			continue;
+
+		if (f->format == CAIRO_FORMAT_RGB16_565) {
+			mix_span565(row16, alpha, s0, s1, w, a, sy, b - a);
+			blend565(f->data16 + fy * f->stride + x + a, row16, alpha, b - a);
+		}
+		else {
+			mix_span(row, s0->data + sy * s0->stride + a, s1->data + sy * s1->stride + a, w, b - a);
+			blend_span(f->data + fy * f->stride + x + a, row, b - a);
+		}
+	}
+}
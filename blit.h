@@ -0,0 +1,96 @@
+/*
+ * blit.h
+ *
+ * Composition of pre-scaled sprites at integer positions
+ *
+ * for the Raspberry Pi and other Linux systems
+ *
+ * Copyright 2019  rricharz
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ *
+ */
+
+#ifndef BLIT_H
+#define BLIT_H
+
+#include <stdint.h>
+#include <cairo.h>
+
+// A sprite is a premultiplied ARGB32 picture, already scaled to the display.
+// Each row is described by spans of opaque and translucent pixels,
+// fully transparent pixels are not part of any span.
+// Opaque spans are copied, only translucent spans need to be blended.
+// To save memory, sprite_reduce stores a sprite as 16 bit colors and a
+// separate 8 bit alpha mask, which is omitted for opaque sprites.
+
+struct span {
+  short x, n;				// first pixel and number of pixels
+  short opaque;
+};
+
+struct sprite {
+  cairo_surface_t *surface;
+  int format;				// CAIRO_FORMAT_ARGB32 or CAIRO_FORMAT_RGB16_565
+  uint32_t *data;			// premultiplied ARGB32 pixels
+  uint16_t *data16;			// or premultiplied 16 bit colors
+  uint8_t *alpha;			// and alpha, 0 if the sprite is opaque
+  int stride;				// in pixels
+  int width, height;
+  int *row;				// first span of each row, height + 1 entries
+  struct span *span;
+  struct span *interior;		// longest opaque span of each row, n = 0 if none
+};
+
+// A frame is the image the sprites are composed into,
+// in the same format as the sprites
+
+struct frame {
+  int format;				// CAIRO_FORMAT_RGB24 or CAIRO_FORMAT_RGB16_565
+  uint32_t *data;
+  uint16_t *data16;
+  int stride;				// in pixels
+  int width, height;
+};
+
+// An occluder is an opaque sprite drawn later on top of a background.
+// The background is not composed where the interior of an occluder covers it.
+// If the occluder is a cross-fade of two sprites, only the common interior is used.
+
+struct occluder {
+  const struct sprite *sprite;
+  int x, y;
+  const struct sprite *mix;		// second sprite of a cross-fade, or 0
+};
+
+#define BLIT_OVER		0		// blend the sprite over the frame
+#define BLIT_SOURCE		1		// replace the frame, including transparent pixels
+
+void blit_init();
+struct sprite *sprite_new(cairo_surface_t *surface);
+void sprite_reduce(struct sprite *s);
+void sprite_free(struct sprite *s);
+void frame_init(struct frame *f, cairo_surface_t *surface);
+void blit(struct frame *f, const struct sprite *s, int x, int y,
+	const cairo_rectangle_int_t *clip, int op);
+void blit_occluded(struct frame *f, const struct sprite *s, int x, int y,
+	const cairo_rectangle_int_t *clip, const struct occluder *o, int n);
+void blit_mix(struct frame *f, const struct sprite *s0, const struct sprite *s1, int w,
+	int x, int y, const cairo_rectangle_int_t *clip);
+void blend_span(uint32_t *dst, const uint32_t *src, int n);
+
+#endif
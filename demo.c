@@ -1,50 +1,85 @@
 /*
  * demo.c
  *
- * Runs a demo on the tu56 visual display of the DECtape TU56 front panel
- * 
+ * Runs a demo on the magtape front panels, and generates tape workloads
+ * for testing the panels without SimH
+ *
+ * usage: demo [-pattern name] [-count n] [-unit 0|1] [-rate hz] [-seed n] [-trace file]
+ *
+ * The patterns are
+ *
+ *   demo        reads a record every 1.4 seconds, the default
+ *   stream      reads long records sequentially, as a restore
+ *   dump        writes long records sequentially, as a dump
+ *   reverse     reads records backwards
+ *   seek        seeks to random positions nearby
+ *   rewind      streams to the end of the tape and rewinds
+ *   bursts      bursts of short records with short gaps
+ *   interleave  streams on unit 0 and unit 1 alternately
+ *
+ * -rate hz rewrites the status hz times per second, even if it does not change,
+ * to stress the status path of the panels. -trace file writes the status changes
+ * with their time as "msec status position" lines for tapexport, instead of
+ * writing the status file in real time.
+ *
  * for the Raspberry Pi and other Linux systems
- * 
+ *
  * Copyright 2019  rricharz
- * 
+ *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
  * the Free Software Foundation; either version 2 of the License, or
  * (at your option) any later version.
- * 
+ *
  * This program is distributed in the hope that it will be useful,
  * but WITHOUT ANY WARRANTY; without even the implied warranty of
  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
  * GNU General Public License for more details.
- * 
+ *
  * You should have received a copy of the GNU General Public License
  * along with this program; if not, write to the Free Software
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
  * MA 02110-1301, USA.
- * 
- * 
+ *
+ *
  */
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
+#include <time.h>
 
-#define TSTATE_ONLINE		 1		// Turns the online light on
-#define TSTATE_DRIVE1		 2		// Selects drive 0 or 1
-#define TSTATE_BACKWARDS	 4		// Sets the direction
-#define TSTATE_SEEK		 	 8		// Spins the reels
-#define TSTATE_READ			16		// Spins the reels
-#define TSTATE_WRITE		32		// Turns the write light on and spins the reels
+#include "tape.h"
+
+#define SPEED			10		// tape speed in positions per msec
+#define OVERHEAD		200		// msec added to every move by the SimH driver
+#define RECORD			10240		// long record in positions
+#define SHORT_RECORD		512
+#define SEEK_RANGE		20000		// maximal distance of random seeks
+#define MAX_MOVE		20000		// msec, the SimH driver does not take longer
 
 static FILE *statusFile = 0;
+static FILE *traceFile = 0;
+static long now;				// time of the workload in msec
+static double rate = 0;				// status updates per second, 0 only on changes
+static int unit = 0;
+static unsigned seed = 1;
 
 void setStatus(int status, long position)
 // set the status bits in the status file
 // if status file is accessible
 {
-	
+
 	char *fname = "/tmp/tu56status";
-	
+	static unsigned long seq = 0;
+	struct timespec ts;
+
+	if (traceFile != 0) {
+		fprintf(traceFile, "%ld %d %ld\n", now, status, position);
+		return;
+	}
+
 	if (statusFile == 0) {
 		statusFile = fopen(fname, "w");
 	}
@@ -52,25 +87,163 @@ void setStatus(int status, long position)
 	if (statusFile != 0) {
 		fseek(statusFile,0L,SEEK_SET);
 		// putc(32 + status,statusFile);
-		fprintf(statusFile, "%c%ld\n", 32 + status, position);
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		fprintf(statusFile, "%c%ld %lld %lu\n", 32 + status, position,
+			(long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000, ++seq);
 		fflush(statusFile);
 	}
 }
 
+static void wait_until(long t)
+// sleep until the time t of the workload
+{
+	static struct timespec start;
+	struct timespec ts;
+
+	if (traceFile != 0)
+		return;
+	if (start.tv_sec == 0)
+		clock_gettime(CLOCK_MONOTONIC, &start);
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	long elapsed = (ts.tv_sec - start.tv_sec) * 1000 + (ts.tv_nsec - start.tv_nsec) / 1000000;
+	if (t > elapsed)
+		usleep((t - elapsed) * 1000);
+}
+
+static void hold(int status, long position, long msec)
+// keep a status for msec, rewritten at the rate of status updates
+{
+	long end = now + msec;
+
+	if ((unit == 1) && (status != 0))
+		status |= TSTATE_DRIVE1;
+	setStatus(status, position);
+	if (rate > 0) {
+		for (double t = now + 1000.0 / rate; t < end; t += 1000.0 / rate) {
+			now = (long)t;
+			wait_until(now);
+			setStatus(status, position);
+		}
+	}
+	now = end;
+	wait_until(now);
+}
+
+static long random_position(long pos)
+// a position near pos, xorshift gives the same workload for the same seed
+{
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	pos += (long)(seed % (2 * SEEK_RANGE + 1)) - SEEK_RANGE;
+	return pos < 0 ? -pos : pos > CAPACITY ? 2 * CAPACITY - pos : pos;
+}
+
+static long move(int status, long pos, long target)
+// move the tape from pos to target at full speed, as the SimH driver reports it
+{
+	long t = labs(target - pos) / SPEED + OVERHEAD;
+	if (target < pos)
+		status |= TSTATE_BACKWARDS;
+	hold(TSTATE_ONLINE | status, target, t < MAX_MOVE ? t : MAX_MOVE);
+	return target;
+}
+
 int main(int argc, char **argv)
-{	
-	long pos;
-	pos = 0;
+{
+	char *pattern = "demo";
+	int count = -1;
+	long pos = 0;
+	long other = 0;				// position on the other unit for interleave
+
+	for (int i = 1; i < argc; i++) {
+		if ((strcmp(argv[i], "-pattern") == 0) && (i + 1 < argc))
+			pattern = argv[++i];
+		else if ((strcmp(argv[i], "-count") == 0) && (i + 1 < argc))
+			count = atoi(argv[++i]);
+		else if ((strcmp(argv[i], "-unit") == 0) && (i + 1 < argc))
+			unit = atoi(argv[++i]) != 0;
+		else if ((strcmp(argv[i], "-rate") == 0) && (i + 1 < argc))
+			rate = atof(argv[++i]);
+		else if ((strcmp(argv[i], "-seed") == 0) && (i + 1 < argc))
+			seed = atoi(argv[++i]) ? atoi(argv[i]) : 1;
+		else if ((strcmp(argv[i], "-trace") == 0) && (i + 1 < argc)) {
+			traceFile = fopen(argv[++i], "w");
+			if (traceFile == 0) {
+				printf("Cannot open %s\n", argv[i]);
+				exit(1);
+			}
+		}
+		else {
+			printf("usage: demo [-pattern demo|stream|dump|reverse|seek|rewind|bursts|interleave]\n"
+				"            [-count n] [-unit 0|1] [-rate hz] [-seed n] [-trace file]\n");
+			exit(1);
+		}
+	}
+
 	setStatus(0, 0);
-	for (int i = 1; i < 100; i++) {
-		setStatus(TSTATE_ONLINE, pos);
-		usleep(1000000);
-		setStatus(TSTATE_ONLINE | TSTATE_READ, pos);
-		usleep(400000);
-		pos +=  10000;
+	if (strcmp(pattern, "demo") == 0) {
+		for (int i = 1; i < (count < 0 ? 100 : count + 1); i++) {
+			hold(TSTATE_ONLINE, pos, 1000);
+			hold(TSTATE_ONLINE | TSTATE_READ, pos, 400);
+			pos +=  10000;
+		}
+	}
+	else if ((strcmp(pattern, "stream") == 0) || (strcmp(pattern, "dump") == 0)) {
+		int status = (pattern[0] == 'd') ? TSTATE_WRITE : TSTATE_READ;
+		for (int i = 0; (i < (count < 0 ? 150 : count)) && (pos + RECORD <= CAPACITY); i++)
+			pos = move(status, pos, pos + RECORD);
+	}
+	else if (strcmp(pattern, "reverse") == 0) {
+		pos = CAPACITY / 2;
+		hold(TSTATE_ONLINE, pos, 500);
+		for (int i = 0; (i < (count < 0 ? 80 : count)) && (pos >= RECORD); i++)
+			pos = move(TSTATE_READ, pos, pos - RECORD);
+	}
+	else if (strcmp(pattern, "seek") == 0) {
+		for (int i = 0; i < (count < 0 ? 50 : count); i++) {
+			pos = move(TSTATE_SEEK, pos, random_position(pos));
+			hold(TSTATE_ONLINE, pos, 50);
+		}
+	}
+	else if (strcmp(pattern, "rewind") == 0) {
+		for (int i = 0; i < (count < 0 ? 3 : count); i++) {
+			// the position jumps close to the end of the tape
+			pos = CAPACITY - 20 * RECORD;
+			hold(TSTATE_ONLINE, pos, 500);
+			while (pos + RECORD <= CAPACITY)
+				pos = move(TSTATE_READ, pos, pos + RECORD);
+			hold(TSTATE_ONLINE, pos, 500);
+			pos = move(TSTATE_SEEK, pos, 0);
+			hold(TSTATE_ONLINE, pos, 500);
+		}
+	}
+	else if (strcmp(pattern, "bursts") == 0) {
+		for (int i = 0; i < (count < 0 ? 20 : count); i++) {
+			for (int j = 0; j < 32; j++) {
+				pos = move(TSTATE_READ, pos, pos + SHORT_RECORD);
+				hold(TSTATE_ONLINE, pos, 5);
+			}
+			hold(TSTATE_ONLINE, pos, 1000);
+		}
+	}
+	else if (strcmp(pattern, "interleave") == 0) {
+		for (int i = 0; i < (count < 0 ? 100 : count); i++) {
+			pos = move(TSTATE_READ, pos, pos + RECORD);
+			unit = !unit;
+			long t = pos;
+			pos = other;
+			other = t;
+		}
+	}
+	else {
+		printf("demo: unknown pattern %s\n", pattern);
+		exit(1);
 	}
 	setStatus(0, 0);
-	fclose(statusFile);	
+	if (statusFile != 0)
+		fclose(statusFile);
+	if (traceFile != 0)
+		fclose(traceFile);
 	return 0;
 }
-
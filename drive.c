@@ -0,0 +1,318 @@
+/*
+ * drive.c
+ *
+ * Tape motion logic of the magtape front panels,
+ * independent of the graphical display
+ * 
+ * for the Raspberry Pi and other Linux systems
+ * 
+ * Copyright 2019  rricharz
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ * 
+ * 
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <sys/time.h>
+
+#include "tape.h"
+
+static struct {
+  int simulated;			// the clock only moves when it is stepped
+  long t;				// time of the simulated clock in msec
+  unsigned random;			// state of the jitter generator, never 0
+} sim = { 0, 0, 1 };
+
+long mSeconds()
+// return time in msec
+{
+	struct timeval tv;
+	if (sim.simulated)
+		return sim.t;
+	gettimeofday(&tv,NULL);
+	return (1000 * tv.tv_sec)  + (tv.tv_usec/1000);
+}
+
+void clock_simulate(long t)
+// replace the real time by a simulated clock, starting at t msec
+{
+	sim.simulated = 1;
+	sim.t = t;
+}
+
+void clock_step(long msec)
+// advance the simulated clock
+{
+	sim.t += msec;
+}
+
+void jitter_seed(unsigned seed)
+{
+	sim.random = seed ? seed : 1;
+}
+
+static int jitter()
+// a pseudo random number between -4 and 3, the same sequence for the same seed
+{
+	// xorshift, the same on all platforms, unlike rand
+	sim.random ^= sim.random << 13;
+	sim.random ^= sim.random >> 17;
+	sim.random ^= sim.random << 5;
+	return (sim.random & 7) - 4;
+}
+
+int getStatusStamp(int *position, long long *stamp, unsigned long *seq)
+// read status and position from the status file, and the time in usec and the
+// sequence number the record was written with, or 0 if the writer does not add them
+// position is not changed if the status file does not exist
+{
+	static FILE *statusFile = 0;
+	char *fname = "/tmp/tu56status";
+	char line[64];
+	int st;
+	
+	*stamp = 0;
+	*seq = 0;
+
+	// file needs to be opened again each time to read new status
+	statusFile = fopen(fname, "r");
+		
+	if (statusFile != 0) {
+		// a shorter record leaves the end of the previous one after its newline
+		if (fgets(line, sizeof(line), statusFile) == 0)
+			line[0] = 0;
+		fclose(statusFile);
+		st = line[0] - 32;
+		if (line[0] != 0)
+			sscanf(line + 1, "%d %lld %lu", position, stamp, seq);
+		if (st >= 0)
+			return st;
+		else
+			return 0;
+	}
+	else return 0;
+}
+
+int getStatus(int *position)
+// read status and position from the status file
+// position is not changed if the status file does not exist
+{
+	long long stamp;
+	unsigned long seq;
+	return getStatusStamp(position, &stamp, &seq);
+}
+
+static double driver_time(int distance)
+// time in msec the SimH driver needs to move the tape by distance positions
+{
+	double t = abs(distance) * 0.1 + 200.0;
+	if (t > 20000.0) t = 20000.0;
+	return t;
+}
+
+static void est_observe(struct estimator *e, long t, int z, int current)
+// feed the position z observed at time t into the velocity estimator
+{
+	if (!e->valid || (t - e->last_t > EST_WINDOW)) {
+		// no recent history, start at the displayed position using the driver timing
+		e->x = current;
+		e->v = (z - current) / driver_time(z - current);
+		e->a = 0.0;
+	}
+	else {
+		double dt = t - e->last_t;
+		if (dt < 1.0) dt = 1.0;
+		double xp = e->x + e->v * dt + 0.5 * e->a * dt * dt;
+		double vp = e->v + e->a * dt;
+		double r = z - xp;
+		e->x = xp + EST_ALPHA * r;
+		e->v = vp + EST_BETA * r / dt;
+		e->a += 2.0 * EST_GAMMA * r / (dt * dt);
+	}
+	if (e->v > MAX_VELOCITY) e->v = MAX_VELOCITY;
+	if (e->v < -MAX_VELOCITY) e->v = -MAX_VELOCITY;
+	
+	e->last_t = t;
+	e->valid = 1;
+}
+
+static int est_position(struct estimator *e, long t, int target)
+// extrapolate the tape position at time t, without passing the target position
+{
+	if (!e->valid)
+		return target;
+	double dt = t - e->last_t;
+	double p = e->x + e->v * dt + 0.5 * e->a * dt * dt;
+	double lo = e->x < target ? e->x : target;
+	double hi = e->x < target ? target : e->x;
+	if (p < lo) p = lo;
+	if (p > hi) p = hi;
+	return (int)p;
+}
+
+void drive_init(struct drive *d, const struct model *m)
+{
+	d->model = m;
+	d->unit = 0;
+	d->label = "";
+	for (int i = 0; i < NUM_BUTTONS; i++)
+		d->buttonState[i] = 0;
+	d->buttonState[BUTTON_ONLINE] = 1;
+	d->remote_status = 0;
+	d->last_remote_status = 0;
+	d->requested_speed1 = 0;
+	d->actual_speed1 = 0;
+	d->requested_speed2 = 0;
+	d->actual_speed2 = 0;
+	d->angle1 = 0;
+	d->angle2 = 100;
+	d->delta_vc1 = 0;
+	d->delta_vc2 = 0;
+	d->radius1 = MIN_TRADIUS;
+	d->radius2 = MAX_TRADIUS;
+	d->position = 0;
+	d->target = 0;
+	d->est.valid = 0;
+	d->tms = mSeconds();
+	d->delta_t = 0;
+}
+
+void do_logic(struct drive *d, int status, int position, long t)
+// logic and feedback circuit
+// status and position have been read from the status file, position is -1 if unknown
+{	
+	int lastTarget = d->target;
+	if (d->buttonState[BUTTON_ONLINE])
+		d->remote_status = status;
+	else {
+		d->remote_status = 0;
+		position = -1;
+	}
+	
+	// the position in the status file belongs to the unit which has written it
+	if ((position >= 0) && (d->unit == ((d->remote_status & TSTATE_DRIVE1) != 0)))
+		d->target = position;
+	
+	if (d->unit && ((d->remote_status & TSTATE_DRIVE1) == 0)) {
+		d->remote_status = 0;
+	 }
+	if ((d->unit == 0) && ((d->remote_status & TSTATE_DRIVE1) != 0)) {
+		d->remote_status = 0;
+	}		
+	
+	d->delta_t = (double)(t - d->tms);
+	d->tms = t;
+	
+	if ((d->last_remote_status != d->remote_status) || (d->target != lastTarget)) {
+		/* printf("*** SimH driver state=0x%02x(%c%c%c%c%c%c), target pos=%d\n",
+			d->remote_status,
+			((d->remote_status & TSTATE_ONLINE)? 'O':'-'),
+			((d->remote_status & TSTATE_WRITE)? 'W':'-'),
+			((d->remote_status & TSTATE_READ)? 'R':'-'),
+			((d->remote_status & TSTATE_SEEK)? 'S':'-'),
+			((d->remote_status & TSTATE_BACKWARDS)? '<':'>'),
+			((d->remote_status & TSTATE_DRIVE1)? '2':'1'),
+			d->target); */
+		if (d->target != lastTarget)
+			est_observe(&d->est, d->tms, d->target, d->position);
+	}
+	
+	// extrapolate the tape position while the tape moves
+	if (d->remote_status & (TSTATE_SEEK | TSTATE_READ | TSTATE_WRITE)) {
+		d->position = est_position(&d->est, d->tms, d->target);
+		// printf("v=%0.2f, a=%0.4f, target position = %d, current position=%d\n",
+		//	d->est.v, d->est.a, d->target, d->position);
+	}
+	else
+		d->position = d->target;
+		
+	// calculate current tape radius for both reels
+	// note: this is NOT a linear relation!
+	
+	if (d->position < 0) d->position = 0;
+	if (d->position > CAPACITY) d->position = CAPACITY;
+	double f0square = (MIN_TRADIUS / MAX_TRADIUS) * (MIN_TRADIUS / MAX_TRADIUS);
+	double f1 = sqrt(((double)d->position / CAPACITY) * (1.0 - f0square) + f0square);
+	double f2 = sqrt(((CAPACITY - (double)d->position) / CAPACITY) * (1.0 - f0square) + f0square);	
+
+	d->radius1 = f1 * MAX_TRADIUS;
+	d->radius2 = f2 * MAX_TRADIUS;
+	
+	// calculate requested reel speeds based on position
+	
+	if ((d->remote_status & TSTATE_WRITE) || (d->remote_status & TSTATE_READ) || (d->remote_status & TSTATE_SEEK)) {
+		d->requested_speed1 = (int)(FULL_RPS * MAX_TRADIUS / d->radius1 + 0.5);
+		d->requested_speed2 = (int)(FULL_RPS * MAX_TRADIUS / d->radius2 + 0.5); 
+	}
+	else {
+		d->requested_speed1 = 0;
+		d->requested_speed2 = 0;
+	}
+	if (d->remote_status & TSTATE_BACKWARDS) {
+		d->requested_speed1 = -d->requested_speed1;
+		d->requested_speed2 = -d->requested_speed2;
+	}
+	
+	// Calculate the actual vacuum column deltas, based on speed differences
+	
+	d->delta_vc1 += d->model->scale_vc * (d->requested_speed1 - d->actual_speed1) * d->delta_t / TIME_INTERVAL;
+	if (fabs(d->requested_speed1 - d->actual_speed1) < ACCELERATION) // move towards center
+		d->delta_vc1 *= 0.9;
+	if (d->actual_speed1 != 0.0) d->delta_vc1 += jitter(); // sligh jitter
+	if (d->delta_vc1 > d->model->vc1.max_delta) d->delta_vc1 = d->model->vc1.max_delta;
+	if (d->delta_vc1 < -d->model->vc1.max_delta) d->delta_vc1 = -d->model->vc1.max_delta;	
+	
+	d->delta_vc2 -= d->model->scale_vc * (d->requested_speed2 - d->actual_speed2) * d->delta_t / TIME_INTERVAL;		
+	if (fabs(d->requested_speed1 - d->actual_speed1) < ACCELERATION) // move towards center
+		d->delta_vc2 *= 0.9;
+	if (d->actual_speed2 != 0.0) d->delta_vc2 += jitter(); // sligh jitter
+	if (d->delta_vc2 > d->model->vc2.max_delta) d->delta_vc2 = d->model->vc2.max_delta;
+	if (d->delta_vc2 < -d->model->vc2.max_delta) d->delta_vc2 = -d->model->vc2.max_delta;
+	
+	// if ((d->delta_vc1) || (d->delta_vc1))
+	//	printf("**dvc1=%0.0f, dvc2=%0.0f\n", d->delta_vc1, d->delta_vc2);
+	
+	// Linear acceleration based on speed differences
+	// Vacuum column deltas are the integrals of the speed differences
+	// Differentiating these again could have been used here,
+	// but the same effect can be obtained by using the speed differences directly
+	
+	if (d->actual_speed1 > d->requested_speed1) d->actual_speed1 -= ACCELERATION;
+	if (d->actual_speed1 < d->requested_speed1) d->actual_speed1 += ACCELERATION;	
+	if (d->actual_speed2 > d->requested_speed2) d->actual_speed2 -= ACCELERATION;
+	if (d->actual_speed2 < d->requested_speed2) d->actual_speed2 += ACCELERATION;
+	
+	// make sure that the reels stop completely
+	
+	if (fabs(d->actual_speed1) < ACCELERATION) d->actual_speed1 = 0.0;
+	if (fabs(d->actual_speed2) < ACCELERATION) d->actual_speed2 = 0.0;	
+
+	// turn the reels
+	
+	double delta_angle1 = d->actual_speed1 * d->delta_t * 0.25 * MAX_TRADIUS / d->radius1;
+	double delta_angle2 = d->actual_speed2 * d->delta_t * 0.25 * MAX_TRADIUS / d->radius2;
+	d->angle1 += delta_angle1;
+	while (d->angle1 >= 360.0) d->angle1 -= 360.0;
+	while (d->angle1 < 0.0) d->angle1 += 360.0;
+	d->angle2 += delta_angle2;
+	while (d->angle2 >= 360.0) d->angle2 -= 360.0;
+	while (d->angle2 < 0.0) d->angle2 += 360.0;
+	
+	d->last_remote_status = d->remote_status;
+}
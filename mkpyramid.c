@@ -0,0 +1,131 @@
+/*
+ * mkpyramid.c
+ *
+ * Generates reduced resolution copies of the pictures of the front panels,
+ * so that small windows do not need to decode and scale the full pictures
+ *
+ * usage: mkpyramid picture.png ...
+ *
+ * Each picture is halved repeatedly, averaging 2 x 2 pixels, and the
+ * levels are stored as pyramid/2/picture.png, pyramid/4/picture.png ...
+ *
+ * for the Raspberry Pi and other Linux systems
+ *
+ * Copyright 2019  rricharz
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <cairo.h>
+
+#include "tape.h"
+
+static void make_dirs(char *path)
+// create all directories leading to the file path
+{
+	for (char *p = strchr(path, '/'); p != 0; p = strchr(p + 1, '/')) {
+		*p = 0;
+		if ((mkdir(path, 0755) != 0) && (errno != EEXIST)) {
+			printf("Cannot create %s\n", path);
+			exit(1);
+		}
+		*p = '/';
+	}
+}
+
+static cairo_surface_t *halve(cairo_surface_t *t)
+// return a picture of half the size, each pixel is the average of 2 x 2 pixels
+{
+	int w = cairo_image_surface_get_width(t);
+	int h = cairo_image_surface_get_height(t);
+	int ws = cairo_image_surface_get_stride(t) / 4;
+	uint32_t *src = (uint32_t *)cairo_image_surface_get_data(t);
+	int hw = (w + 1) / 2, hh = (h + 1) / 2;
+	cairo_surface_t *r = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, hw, hh);
+	int rs = cairo_image_surface_get_stride(r) / 4;
+	uint32_t *dst = (uint32_t *)cairo_image_surface_get_data(r);
+
+	for (int y = 0; y < hh; y++) {
+		for (int x = 0; x < hw; x++) {
+			// at odd edges, the last row or column is used twice
+			int x0 = 2 * x, x1 = (2 * x + 1 < w) ? 2 * x + 1 : 2 * x;
+			int y0 = 2 * y, y1 = (2 * y + 1 < h) ? 2 * y + 1 : 2 * y;
+			uint32_t p[4] = { src[y0 * ws + x0], src[y0 * ws + x1],
+				src[y1 * ws + x0], src[y1 * ws + x1] };
+			uint32_t v = 0;
+			for (int c = 0; c < 32; c += 8) {
+				int sum = 2;
+				for (int i = 0; i < 4; i++)
+					sum += (p[i] >> c) & 255;
+				v |= (uint32_t)(sum / 4) << c;
+			}
+			dst[y * rs + x] = v;
+		}
+	}
+	cairo_surface_mark_dirty(r);
+	return r;
+}
+
+int main(int argc, char *argv[])
+{
+	char s[256];
+
+	if (argc < 2) {
+		printf("usage: mkpyramid picture.png ...\n");
+		exit(1);
+	}
+
+	for (int i = 1; i < argc; i++) {
+		cairo_surface_t *t = cairo_image_surface_create_from_png(argv[i]);
+		if ((t == 0) || cairo_surface_status(t)) {
+			printf("Cannot load %s\n", argv[i]);
+			exit(1);
+		}
+		if (cairo_image_surface_get_format(t) != CAIRO_FORMAT_ARGB32) {
+			// make sure that the pixels are 32 bit
+			cairo_surface_t *c = cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
+				cairo_image_surface_get_width(t), cairo_image_surface_get_height(t));
+			cairo_t *cr = cairo_create(c);
+			cairo_set_source_surface(cr, t, 0, 0);
+			cairo_paint(cr);
+			cairo_destroy(cr);
+			cairo_surface_destroy(t);
+			t = c;
+		}
+		cairo_surface_flush(t);
+		for (int level = 2; level <= PYRAMID_LEVELS; level *= 2) {
+			cairo_surface_t *h = halve(t);
+			cairo_surface_destroy(t);
+			t = h;
+			snprintf(s, sizeof(s), "%s/%d/%s", PYRAMID_DIR, level, argv[i]);
+			make_dirs(s);
+			if (cairo_surface_write_to_png(t, s) != CAIRO_STATUS_SUCCESS) {
+				printf("Cannot write %s\n", s);
+				exit(1);
+			}
+		}
+		cairo_surface_destroy(t);
+	}
+	return 0;
+}
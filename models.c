@@ -0,0 +1,92 @@
+/*
+ * models.c
+ *
+ * Descriptions of the emulated magtape drives
+ * 
+ * for the Raspberry Pi and other Linux systems
+ * 
+ * Copyright 2019  rricharz
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ * 
+ * 
+ */
+
+#include <string.h>
+
+#include "tape.h"
+
+const struct model tu77_model = {
+	.name		= "tu77",
+	.image		= "Tu77-open.png",
+	.capstan	= "reels/capstan2.png",
+	.capstanb	= { "reels/capstan2b1.png", "reels/capstan2b2.png" },
+	.capstanx	= 616,
+	.capstany	= 836,
+	.reel1x		= 130,
+	.reel1y		= 577,
+	.reel2x		= 150,
+	.reel2y		= 43,
+	.columnStyle	= COLUMN_ARC,
+	.vc1		= { 717, 600, 39, 850, 850, -1, 300 },
+	.vc2		= { 807, 480, 39, 163, 163,  1, 300 },
+	.scale_vc	= 2.2,
+	.wheel		= "reels/wheel.png",
+	.wheelb		= { "reels/wheelb1.png", "reels/wheelb2.png" },
+	.numwheels	= 3,
+	.wheelx		= { 666, 718, 590 },
+	.wheely		= { 128, 128, 395 },
+	.numbuttons	= 4,
+	.buttonx	= 194,
+	.buttony	= 539,
+	.buttonsize	= 21,
+	.buttonoffset	= 41,
+	.led_power_x	= 161,
+	.led_online_x	= 267,
+	.led_bot_x	= 208,
+	.led_y		= 515,
+	.led_radius	= 5,
+};
+
+const struct model te16_model = {
+	.name		= "te16",
+	.image		= "Te16-open.png",
+	.capstan	= "reels/capstan.png",
+	.capstanb	= { "reels/capstanb1.png", "reels/capstanb2.png" },
+	.capstanx	= 185,
+	.capstany	= 105,
+	.reel1x		= 370,
+	.reel1y		= 98,
+	.reel2x		= 365,
+	.reel2y		= 568,
+	.columnStyle	= COLUMN_LOOP,
+	.vc1		= { 149, 450, 37,  90, 140, 1, 260 },
+	.vc2		= { 295, 750, 36, 530, 575, 1, 230 },
+	.scale_vc	= 2.0,
+	.numwheels	= 0,
+	.numbuttons	= 0,
+};
+
+const struct model *models[] = { &tu77_model, &te16_model, 0 };
+
+const struct model *find_model(char *name)
+// return the model with the given name, 0 if there is none
+{
+	for (int i = 0; models[i] != 0; i++)
+		if (strcmp(models[i]->name, name) == 0)
+			return models[i];
+	return 0;
+}
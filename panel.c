@@ -0,0 +1,1100 @@
+/*
+ * panel.c
+ *
+ * Graphical display of the magtape front panels,
+ * shared by all drive models
+ *
+ * for the Raspberry Pi and other Linux systems
+ *
+ * Copyright 2019  rricharz
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ *
+ */
+
+#define BORDER 80       // we need to make an educated guess to make sure that the full vertical
+                        // space is used if required
+                        // if BORDER is too small, we might end up with a too large window
+                        // if BORDER is too large, the decorated window will be smaller than possible
+                        // with a reasonable size BORDER, both are acceptable
+                        // ideally, one could force the window manager to use a certain aspect ratio
+
+#define GDK_DISABLE_DEPRECATION_WARNINGS
+
+#include <cairo.h>
+#include <math.h>
+#include <gtk/gtk.h>
+#include <glib-unix.h>
+#include <unistd.h>
+
+#include "render.h"
+#include "share.h"
+#include "stream.h"
+#include "sound.h"
+#include "bench.h"
+
+// A tile is the part of a view composed by one thread
+
+#define TILE_SIZE	128		// in pixels
+#define MAX_WORKERS	7		// threads composing tiles in addition to the render thread
+
+struct tile {
+  int view;
+  cairo_rectangle_int_t clip;
+};
+
+static struct {
+  struct cache *cache;			// newest cache, used by the main thread
+  int building;				// a new cache is being built
+  GThread *cache_loader;		// thread building it, or 0
+  GSList *blur_loaders;			// threads decoding blurred pictures
+  double scale;				// scale and offset of the drives in the window
+  double fraction;			// the frames are composed at this fraction of the scale
+  int argFullscreen, argFullv;
+  int argShare;
+  char *argHttp;				// [address:]port of the stream, or 0
+  int argSimclock;			// every timer event advances the clock by TIME_INTERVAL
+  gint64 stopped;			// monotonic time in usec when the timer was stopped
+  char *argSound;			// aplay or a WAV file, or 0
+  struct sound *sound;			// sound of the reels, or 0
+  char *argBench;			// report file of the benchmark, or 0
+  struct bench *bench;			// measures the panel, or 0
+  unsigned long observed;		// last status change observed by the benchmark
+  int xoffset;
+  int width, height;			// size of all drives in dots
+  guint timer;				// timer source, 0 while all drives are idle
+  GFileMonitor *monitor;		// notifies changes of the status file
+  struct view view[MAX_DRIVES];
+  int numviews;
+  GtkWidget *window;
+
+  // The drives are composed by a render thread into two frames. The frame
+  // completed last is shown by the draw handler, the other one is composed.
+  GThread *render_thread;
+  GMutex lock;				// protects all fields below
+  GCond wake;				// wakes up the render thread
+  struct view shown[MAX_DRIVES];	// copy of the drives to be composed
+  unsigned damage;			// views to be composed, one bit per view
+  unsigned pending[2];			// views not yet composed into each frame
+  unsigned ready;			// views composed but not yet shown
+  cairo_surface_t *frame[2];
+  int front;				// index of the frame shown
+  int width_req, height_req;		// size of the window
+  double scale_req;			// scale and offset in the window
+  int xoffset_req;
+  double frame_scale[2];		// scale and offset each frame is composed with
+  int frame_xoffset[2];
+  struct share *share;			// frames published in shared memory, or 0
+  struct stream *stream;		// frames streamed over HTTP, or 0
+  unsigned long observed_req;		// last status change before the views were copied
+  unsigned long frame_observed[2];	// last status change each frame shows
+  struct cache *next_cache;		// cache to be used for the next frame
+  struct blur_job *next_blur;		// blurred pictures to be added before the next frame
+  int quit;
+
+  // used by the render thread and the workers only
+  struct cache *draw_cache;
+  int draw_xoffset;
+
+  // The render thread splits the views to be composed into tiles, which are composed
+  // concurrently by the render thread and a pool of workers into the same frame
+  int numworkers;
+  GThread *workers[MAX_WORKERS];
+  GMutex pool_lock;			// protects generation, busy and pool_quit
+  GCond pool_start, pool_done;
+  int generation;			// incremented for every set of tiles
+  int busy;				// number of workers still composing
+  int pool_quit;
+  struct tile *tiles;
+  int numtiles, maxtiles;
+  int next_tile;			// next tile to be composed, atomic
+  struct frame tile_frame;
+  struct view *tile_views;
+} glob;
+
+#define ALL_VIEWS	((1u << glob.numviews) - 1)
+
+static void start_rebuild();
+static void start_blur_loading();
+static void use_blur_job(struct blur_job *job, struct cache *c);
+static void queue_draw_view(GtkWidget *widget, struct view *v);
+
+static void request_render(unsigned views)
+// ask the render thread to compose the views in the current state of the drives
+{
+	if (views == 0)
+		return;
+	g_mutex_lock(&glob.lock);
+	memcpy(glob.shown, glob.view, sizeof(glob.shown));
+	glob.scale_req = glob.scale;
+	glob.xoffset_req = glob.xoffset;
+	glob.observed_req = glob.observed;
+	glob.damage |= views;
+	g_cond_signal(&glob.wake);
+	g_mutex_unlock(&glob.lock);
+}
+
+static gboolean on_stream_viewer(gpointer data)
+// called in the main thread when a viewer connects while the frames are not streamed
+{
+	request_render(ALL_VIEWS);
+	return FALSE;
+}
+
+static gboolean on_frame_ready(gpointer data)
+// called in the main thread when the render thread has completed a frame
+{
+	g_mutex_lock(&glob.lock);
+	unsigned views = glob.ready;
+	glob.ready = 0;
+	g_mutex_unlock(&glob.lock);
+	for (int i = 0; i < glob.numviews; i++)
+		if (views & (1u << i))
+			queue_draw_view(glob.window, &glob.view[i]);
+	return FALSE;
+}
+
+static void compose_tiles()
+// compose tiles until none are left, called by the render thread and the workers
+{
+	int i;
+	while ((i = g_atomic_int_add(&glob.next_tile, 1)) < glob.numtiles)
+		render_view(&glob.tile_frame, glob.draw_cache, glob.draw_xoffset,
+			&glob.tile_views[glob.tiles[i].view], &glob.draw_cache->view[glob.tiles[i].view],
+			&glob.tiles[i].clip);
+}
+
+static gpointer worker_loop(gpointer data)
+{
+	int generation = 0;
+
+	g_mutex_lock(&glob.pool_lock);
+	for (;;) {
+		while (!glob.pool_quit && (glob.generation == generation))
+			g_cond_wait(&glob.pool_start, &glob.pool_lock);
+		if (glob.pool_quit)
+			break;
+		generation = glob.generation;
+		g_mutex_unlock(&glob.pool_lock);
+		compose_tiles();
+		g_mutex_lock(&glob.pool_lock);
+		if (--glob.busy == 0)
+			g_cond_signal(&glob.pool_done);
+	}
+	g_mutex_unlock(&glob.pool_lock);
+	return 0;
+}
+
+static void add_tile(int view, int x, int y, int width, int height)
+{
+	if (glob.numtiles >= glob.maxtiles) {
+		glob.maxtiles = 2 * glob.maxtiles + 16;
+		glob.tiles = g_renew(struct tile, glob.tiles, glob.maxtiles);
+	}
+	struct tile *t = &glob.tiles[glob.numtiles++];
+	t->view = view;
+	t->clip.x = x;
+	t->clip.y = y;
+	t->clip.width = width;
+	t->clip.height = height;
+}
+
+static void view_rect(const struct view *v, int width, int height, int *x0, int *x1, int *y1)
+// the columns x0 to x1 and the rows 0 to y1 of a frame show the view
+{
+	*x0 = px(glob.draw_cache, v->x + glob.draw_xoffset);
+	*x1 = px(glob.draw_cache, v->x + glob.draw_xoffset + v->width);
+	*y1 = px(glob.draw_cache, v->height);
+	if (*x0 < 0) *x0 = 0;
+	if (*x1 > width) *x1 = width;
+	if (*y1 > height) *y1 = height;
+}
+
+static void damage_rect(cairo_surface_t *frame, struct view *views, unsigned damage,
+	cairo_rectangle_int_t *r)
+// the bounding rectangle of the views in damage
+{
+	int width = cairo_image_surface_get_width(frame);
+	int height = cairo_image_surface_get_height(frame);
+	int left = width, right = 0, bottom = 0;
+
+	for (int i = 0; i < glob.numviews; i++) {
+		if (!(damage & (1u << i)))
+			continue;
+		int x0, x1, y1;
+		view_rect(&views[i], width, height, &x0, &x1, &y1);
+		if (x0 < left) left = x0;
+		if (x1 > right) right = x1;
+		if (y1 > bottom) bottom = y1;
+	}
+	r->x = (left < right) ? left : 0;
+	r->y = 0;
+	r->width = (left < right) ? right - left : 0;
+	r->height = bottom;
+}
+
+static void add_change(cairo_rectangle_int_t *r, int *n, double x0, double y0, double x1, double y1)
+// a rectangle in dots of the drive picture, which has changed, in pixels of the frame
+{
+	r[*n].x = px(glob.draw_cache, x0) - 2;
+	r[*n].y = px(glob.draw_cache, y0) - 2;
+	r[*n].width = px(glob.draw_cache, x1) - r[*n].x + 4;
+	r[*n].height = px(glob.draw_cache, y1) - r[*n].y + 4;
+	(*n)++;
+}
+
+static void add_column_change(cairo_rectangle_int_t *r, int *n, int ox, const struct column *c,
+	double delta1, double delta2)
+// the part of a vacuum column between the tops and the lower of two tape loops
+{
+	double y1 = c->y + c->dir * delta1, y2 = c->y + c->dir * delta2;
+	double top = c->topl < c->topr ? c->topl : c->topr;
+	double lo = (y1 < y2 ? y1 : y2) - c->r, hi = (y1 > y2 ? y1 : y2) + c->r;
+	add_change(r, n, c->x + ox - c->r, top < lo ? top : lo, c->x + ox + c->r, hi);
+}
+
+static int sprite_size(const struct sprite *a, const struct sprite *b, const struct sprite *c, int h)
+// the larger width or height (h) of the sharp and the blurred sprites
+{
+	int m = 0;
+	const struct sprite *sp[3] = { a, b, c };
+	for (int i = 0; i < 3; i++)
+		if ((sp[i] != 0) && ((h ? sp[i]->height : sp[i]->width) > m))
+			m = h ? sp[i]->height : sp[i]->width;
+	return m;
+}
+
+static int view_changes(int i, const struct view *old, const struct view *v, cairo_rectangle_int_t *r)
+// the rectangles of a view which differ between the state old and the state v,
+// these are the only parts of the view which need to be composed again
+{
+	const struct drive *o = &old->drive, *d = &v->drive;
+	const struct model *m = d->model;
+	const struct view_sprites *vs = &glob.draw_cache->view[i];
+	double w = glob.draw_cache->reelw, h = glob.draw_cache->reelh;
+	int ox = v->x + glob.draw_xoffset;
+	int n = 0;
+
+	if ((o->angle1 != d->angle1) || (o->actual_speed1 != d->actual_speed1) || (o->radius1 != d->radius1))
+		add_change(r, &n, m->reel1x + ox, m->reel1y, m->reel1x + ox + w, m->reel1y + h);
+	if ((o->angle2 != d->angle2) || (o->actual_speed2 != d->actual_speed2) || (o->radius2 != d->radius2)
+			|| (o->label != d->label))
+		add_change(r, &n, m->reel2x + ox, m->reel2y, m->reel2x + ox + w, m->reel2y + h);
+	if (((o->requested_speed1 != 0.0) != (d->requested_speed1 != 0.0))
+			|| (old->capstan_index != v->capstan_index)) {
+		// the sprites are in pixels
+		double s = glob.draw_cache->scale;
+		add_change(r, &n, m->capstanx + ox, m->capstany,
+			m->capstanx + ox + sprite_size(vs->capstan, vs->capstanb[0], vs->capstanb[1], 0) / s,
+			m->capstany + sprite_size(vs->capstan, vs->capstanb[0], vs->capstanb[1], 1) / s);
+		for (int k = 0; k < m->numwheels; k++)
+			add_change(r, &n, m->wheelx[k] + ox, m->wheely[k],
+				m->wheelx[k] + ox + sprite_size(vs->wheel, vs->wheelb[0], vs->wheelb[1], 0) / s,
+				m->wheely[k] + sprite_size(vs->wheel, vs->wheelb[0], vs->wheelb[1], 1) / s);
+	}
+	if (o->delta_vc1 != d->delta_vc1)
+		add_column_change(r, &n, ox, &m->vc1, o->delta_vc1, d->delta_vc1);
+	if (o->delta_vc2 != d->delta_vc2)
+		add_column_change(r, &n, ox, &m->vc2, o->delta_vc2, d->delta_vc2);
+	if ((m->numbuttons > 0) && ((o->buttonState[BUTTON_ONLINE] != d->buttonState[BUTTON_ONLINE])
+			|| ((o->position == 0) != (d->position == 0)))) {
+		int x0 = m->led_power_x, x1 = m->led_power_x;
+		if (m->led_online_x < x0) x0 = m->led_online_x;
+		if (m->led_bot_x < x0) x0 = m->led_bot_x;
+		if (m->led_online_x > x1) x1 = m->led_online_x;
+		if (m->led_bot_x > x1) x1 = m->led_bot_x;
+		add_change(r, &n, x0 + ox - m->led_radius, m->led_y - m->led_radius,
+			x1 + ox + m->led_radius, m->led_y + m->led_radius);
+	}
+	return n;
+}
+
+static int intersects(const cairo_rectangle_int_t *a, const cairo_rectangle_int_t *r, int n)
+{
+	for (int i = 0; i < n; i++)
+		if ((a->x < r[i].x + r[i].width) && (r[i].x < a->x + a->width) &&
+				(a->y < r[i].y + r[i].height) && (r[i].y < a->y + a->height))
+			return 1;
+	return 0;
+}
+
+static void compose_frame(cairo_surface_t *frame, struct view *views, const struct view *old,
+	unsigned todo, unsigned full)
+// compose the views in todo into the frame, using all workers. The views in full are
+// composed completely, the others only where they differ from old, the views in the frame
+{
+	int width = cairo_image_surface_get_width(frame);
+	int height = cairo_image_surface_get_height(frame);
+
+	// only the tiles which intersect a change are scheduled
+	glob.numtiles = 0;
+	for (int i = 0; i < glob.numviews; i++) {
+		if (!(todo & (1u << i)))
+			continue;
+		cairo_rectangle_int_t changes[6 + MAX_WHEELS];
+		int n = (full & (1u << i)) ? 0 : view_changes(i, &old[i], &views[i], changes);
+		int x0, x1, y1;
+		view_rect(&views[i], width, height, &x0, &x1, &y1);
+		for (int y = 0; y < y1; y += TILE_SIZE) {
+			for (int x = x0 - x0 % TILE_SIZE; x < x1; x += TILE_SIZE) {
+				int a = x < x0 ? x0 : x;
+				int b = x + TILE_SIZE < x1 ? x + TILE_SIZE : x1;
+				cairo_rectangle_int_t t = { a, y, b - a, (y + TILE_SIZE < y1 ? y + TILE_SIZE : y1) - y };
+				if ((full & (1u << i)) || intersects(&t, changes, n))
+					add_tile(i, t.x, t.y, t.width, t.height);
+			}
+		}
+	}
+
+	frame_init(&glob.tile_frame, frame);
+	glob.tile_views = views;
+	g_atomic_int_set(&glob.next_tile, 0);
+
+	g_mutex_lock(&glob.pool_lock);
+	glob.busy = glob.numworkers;
+	glob.generation++;
+	g_cond_broadcast(&glob.pool_start);
+	g_mutex_unlock(&glob.pool_lock);
+
+	compose_tiles();
+
+	g_mutex_lock(&glob.pool_lock);
+	while (glob.busy > 0)
+		g_cond_wait(&glob.pool_done, &glob.pool_lock);
+	g_mutex_unlock(&glob.pool_lock);
+
+	cairo_surface_mark_dirty(frame);
+}
+
+static gboolean on_cache_retired(gpointer data)
+// called in the main thread when the render thread does not use a cache anymore
+{
+	free_cache(data);
+	return FALSE;
+}
+
+static gpointer render_loop(gpointer data)
+{
+	struct view views[MAX_DRIVES];
+	struct view composed[2][MAX_DRIVES];	// the views as they are in each frame
+	unsigned full[2] = { ~0u, ~0u };	// views to be composed completely into each frame
+	int shared[2] = { 0, 0 };		// the frame is in the shared memory
+
+	g_mutex_lock(&glob.lock);
+	for (;;) {
+		while (!glob.quit && (glob.damage == 0))
+			g_cond_wait(&glob.wake, &glob.lock);
+		if (glob.quit)
+			break;
+
+		// a new cache is used from the next frame on, the old one is freed by the main thread
+		if (glob.next_cache != 0) {
+			g_idle_add(on_cache_retired, glob.draw_cache);
+			glob.draw_cache = glob.next_cache;
+			glob.next_cache = 0;
+			full[0] = full[1] = ~0u;
+		}
+		// the workers read the sprites without lock, they are only replaced between frames
+		if (glob.next_blur != 0) {
+			use_blur_job(glob.next_blur, glob.draw_cache);
+			glob.next_blur = 0;
+			full[0] = full[1] = ~0u;
+		}
+		double scale = glob.draw_cache->scale;
+
+		// both frames need to be updated, the back frame now
+		int back = 1 - glob.front;
+		int width = (int)ceil(glob.width_req * scale / glob.scale_req);
+		int height = (int)ceil(glob.height_req * scale / glob.scale_req);
+		int xoffset = glob.xoffset_req;
+		int same = (glob.frame_scale[back] == scale) && (glob.frame_xoffset[back] == xoffset);
+		glob.pending[0] |= glob.damage;
+		glob.pending[1] |= glob.damage;
+		unsigned damage = glob.damage;		// changed since the front frame
+		glob.damage = 0;
+		unsigned todo = glob.pending[back];
+		glob.pending[back] = 0;
+		memcpy(views, glob.shown, sizeof(views));
+		unsigned long observed = glob.observed_req;
+		cairo_surface_t *frame = glob.frame[back];
+		g_mutex_unlock(&glob.lock);
+
+		glob.draw_xoffset = xoffset;
+		if (!same)
+			full[back] = todo = damage = ALL_VIEWS;
+		if ((frame == 0) || (cairo_image_surface_get_width(frame) != width)
+				|| (cairo_image_surface_get_height(frame) != height)) {
+			cairo_format_t format = ropt.lowmem ? CAIRO_FORMAT_RGB16_565 : CAIRO_FORMAT_RGB24;
+			if (frame != 0)
+				cairo_surface_destroy(frame);
+			frame = glob.share ? share_surface(glob.share, back, format, width, height) : 0;
+			shared[back] = frame != 0;
+			if (frame == 0)
+				frame = cairo_image_surface_create(format, width, height);
+			full[back] = todo = damage = ALL_VIEWS;
+		}
+		if (shared[back])
+			share_begin(glob.share, back);
+		compose_frame(frame, views, composed[back], todo, full[back]);
+		for (int i = 0; i < glob.numviews; i++)
+			if (todo & (1u << i))
+				composed[back][i] = views[i];
+		full[back] &= ~todo;
+		if (shared[back] || (glob.stream != 0)) {
+			cairo_rectangle_int_t r;
+			damage_rect(frame, views, damage, &r);
+			if (shared[back])
+				share_publish(glob.share, back, &r);
+			if (glob.stream != 0)
+				stream_frame(glob.stream, frame, &r);
+		}
+		if (glob.bench != 0)
+			bench_composed(glob.bench);
+
+		g_mutex_lock(&glob.lock);
+		glob.frame[back] = frame;
+		glob.frame_scale[back] = scale;
+		glob.frame_xoffset[back] = xoffset;
+		glob.frame_observed[back] = observed;
+		glob.front = back;
+		if (glob.ready == 0)
+			g_idle_add(on_frame_ready, 0);
+		glob.ready |= todo;
+	}
+	g_mutex_unlock(&glob.lock);
+	return 0;
+}
+
+static void fit_window(int width, int height)
+// derive the scale and the offset of the drives from the size of the window
+{
+	double scale = (double)height / glob.height;
+	if (scale * glob.width > width)
+		scale = (double)width / glob.width;
+	// small changes are not worth new sprites
+	int same = fabs(scale * glob.fraction - glob.cache->scale) < 0.005 * glob.cache->scale;
+	if (same)
+		scale = glob.cache->scale / glob.fraction;
+	glob.scale = scale;
+	glob.xoffset = (int)((width / scale - glob.width) / 2.0);
+	if (!same)
+		start_rebuild();
+}
+
+static gboolean on_draw_event(GtkWidget *widget, cairo_t *cr, gpointer user_data)
+// only shows the frame completed last, the frames are composed by the render thread
+{
+	int width = gtk_widget_get_allocated_width(widget);
+	int height = gtk_widget_get_allocated_height(widget);
+	int resized = (width != glob.width_req) || (height != glob.height_req);
+
+	if (resized)
+		fit_window(width, height);
+
+	g_mutex_lock(&glob.lock);
+	glob.width_req = width;
+	glob.height_req = height;
+	cairo_surface_t *frame = glob.frame[glob.front];
+	unsigned long observed = glob.frame_observed[glob.front];
+	if (frame != 0) {
+		// a frame composed with a different scale or offset is scaled by cairo
+		double fs = glob.frame_scale[glob.front];
+		int fx = glob.frame_xoffset[glob.front];
+		if ((fs != glob.scale) || (fx != glob.xoffset)) {
+			cairo_translate(cr, (glob.xoffset - fx) * glob.scale, 0);
+			cairo_scale(cr, glob.scale / fs, glob.scale / fs);
+		}
+		cairo_set_source_surface(cr, frame, 0, 0);
+		cairo_pattern_set_filter(cairo_get_source(cr), CAIRO_FILTER_BILINEAR);
+		cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+		cairo_paint(cr);
+	}
+	g_mutex_unlock(&glob.lock);
+
+	if ((glob.bench != 0) && (frame != 0))
+		bench_drawn(glob.bench, observed);
+	if (resized)
+		request_render(ALL_VIEWS);
+	return FALSE;
+}
+
+static void queue_draw_view(GtkWidget *widget, struct view *v)
+{
+	gtk_widget_queue_draw_area(widget,
+		(int)floor((v->x + glob.xoffset) * glob.scale), 0,
+		(int)ceil(v->width * glob.scale) + 1, (int)ceil(v->height * glob.scale) + 1);
+}
+
+static gboolean on_timer_event(GtkWidget *widget)
+{
+	int idle = 1;
+	unsigned views = 0;
+
+	// the status file is read once for all drives
+	int position = -1;
+	long long stamp;
+	unsigned long seq;
+	int status = getStatusStamp(&position, &stamp, &seq);
+	if (glob.bench != 0)
+		glob.observed = bench_observe(glob.bench, status, position, stamp, seq);
+	if (glob.argSimclock)
+		clock_step(TIME_INTERVAL);
+	long t = mSeconds();
+
+	for (int i = 0; i < glob.numviews; i++) {
+		struct view *v = &glob.view[i];
+		struct drive *d = &v->drive;
+
+		do_logic(d, status, position, t);
+		if (glob.sound != 0)
+			sound_set(glob.sound, i, d->actual_speed1, d->actual_speed2);
+		if ((glob.cache->blur == 0) && ((d->requested_speed1 != 0) || (d->requested_speed2 != 0)))
+			start_blur_loading();
+
+		if ((d->actual_speed1 != 0) || (d->actual_speed2 != 0)) {
+			views |= 1u << i;
+			v->moving = 1;
+		}
+		else if (v->moving) { // draw the reels once more when moving stops
+			views |= 1u << i;
+			v->moving = 0;
+		}
+		if (d->requested_speed1 != 0.0)
+			v->capstan_index = (v->capstan_index + 1) & 1;
+		if (v->moving || (d->requested_speed1 != 0) || (d->requested_speed2 != 0))
+			idle = 0;
+	}
+	request_render(views);
+	if (glob.bench != 0)
+		bench_rendered(glob.bench, views != 0);
+
+	// stop the timer while all reels are at rest, a change of the status file restarts it
+	if ((glob.monitor != 0) && idle) {
+		glob.timer = 0;
+		glob.stopped = g_get_monotonic_time();
+		return FALSE;
+	}
+	return TRUE;
+
+}
+
+static void start_timer(GtkWidget *widget)
+{
+	if ((glob.timer == 0) && (TIME_INTERVAL > 0)) {
+		// the simulated clock also passes the timer events missed while idle
+		if (glob.argSimclock && (glob.stopped != 0))
+			clock_step((g_get_monotonic_time() - glob.stopped) / (1000 * TIME_INTERVAL) * TIME_INTERVAL);
+		long t = mSeconds();
+		for (int i = 0; i < glob.numviews; i++)
+			glob.view[i].drive.tms = t; // do not count the idle time
+		// Register the timer and set time in mS.
+		// The timer_event() function is called repeatedly until it returns FALSE.
+		glob.timer = g_timeout_add(TIME_INTERVAL, (GSourceFunc) on_timer_event, (gpointer) widget);
+	}
+}
+
+static void on_status_changed(GFileMonitor *monitor, GFile *file, GFile *other_file,
+	GFileMonitorEvent event_type, gpointer user_data)
+{
+	start_timer(GTK_WIDGET(user_data));
+}
+
+static gboolean on_button_click_event(GtkWidget *widget, GdkEventButton *event, gpointer user_data)
+{
+	// event-button = 1: means left mouse button; button = 3 means right mouse button
+	// printf("on_button_click_event called, button %d, x = %d, y= %d\n", (int)event->button, (int)event->x, (int)event->y);
+
+	int x = (int)((double)event->x / glob.scale) - glob.xoffset;
+	int y = (int)((double)event->y / glob.scale);
+	if (event->button != 1)
+		return TRUE;
+	for (int j = 0; j < glob.numviews; j++) {
+		struct view *v = &glob.view[j];
+		struct drive *d = &v->drive;
+		const struct model *m = d->model;
+		int vx = x - v->x;
+		if ((vx < 0) || (vx >= v->width))
+			continue;
+		for (int i = 0; i < m->numbuttons; i++) {
+			if ((vx >= m->buttonx + i * m->buttonoffset)
+					&& (vx <= m->buttonx + i * m->buttonoffset + m->buttonsize)
+					&& (y >= m->buttony) && (y <= m->buttony + m->buttonsize)) {
+				d->buttonState[i] = !d->buttonState[i];
+				request_render(1u << j);
+				start_timer(widget);
+				// printf("button state %d = %d\n",i, d->buttonState[i]);
+				return TRUE;
+			}
+		}
+	}
+	return TRUE;
+}
+
+static void on_quit_event()
+// panel_main cleans up when gtk_main returns
+{
+	gtk_main_quit();
+}
+
+static gboolean on_signal(gpointer data)
+// the benchmark stops the panel with SIGTERM, the report is written when gtk_main returns
+{
+	on_quit_event();
+	return G_SOURCE_REMOVE;
+}
+
+static void set_fraction(int step)
+// compose the frames at the next larger (step 1) or smaller (step -1) fraction of the window
+{
+	static const double fractions[] = { 0.25, 0.35, 0.5, 0.75, 1.0 };
+	int n = sizeof(fractions) / sizeof(fractions[0]);
+	int i;
+	if (step > 0)
+		for (i = 0; (i < n - 1) && (fractions[i] <= glob.fraction + 1e-6); i++) ;
+	else
+		for (i = n - 1; (i > 0) && (fractions[i] >= glob.fraction - 1e-6); i--) ;
+	glob.fraction = fractions[i];
+	printf("Composing at %0.0f%% of the window resolution\n", glob.fraction * 100.0);
+	fit_window(glob.width_req, glob.height_req);
+	request_render(ALL_VIEWS);
+}
+
+static void on_key_press(GtkWidget *widget, GdkEventKey *event, gpointer user_data)
+{
+	// printf("key pressed, state =%04X, keyval =%04X\n", event->state, event->keyval);
+	if ((event->state == 0x4) && (event->keyval == 0x0063)) // ctrl-c
+		on_quit_event();
+	else if ((event->state == 0x4) && (event->keyval == 0x0071)) // ctrl-q
+		on_quit_event();
+	else if ((event->state == 0x0) && (event->keyval == 0xFF1B)) // esc
+		on_quit_event();
+	else if ((event->keyval == 0x002B) || (event->keyval == 0xFFAB)) // +
+		set_fraction(1);
+	else if ((event->keyval == 0x002D) || (event->keyval == 0xFFAD)) // -
+		set_fraction(-1);
+}
+
+// The blurred pictures are only needed when the tape moves.
+// They are decoded by a separate thread when a drive starts to move for the first time,
+// until then the sharp pictures are drawn instead.
+
+struct blur_job {
+  int serial;				// of the cache the pictures are scaled for
+  double scale;
+  int n;
+  char *name[4 * NUMANGLES + 4 * MAX_DRIVES];
+  struct sprite *sprite[4 * NUMANGLES + 4 * MAX_DRIVES];
+};
+
+static void add_blur_name(struct blur_job *job, char *s)
+{
+	for (int i = 0; i < job->n; i++)
+		if (strcmp(job->name[i], s) == 0)
+			return;
+	job->name[job->n++] = g_strdup(s);
+}
+
+static void free_blur_job(struct blur_job *job)
+{
+	for (int i = 0; i < job->n; i++) {
+		sprite_free(job->sprite[i]);
+		g_free(job->name[i]);
+	}
+	g_free(job);
+}
+
+static void use_blur_job(struct blur_job *job, struct cache *c)
+// called by the render thread between frames, with glob.lock held
+{
+	if (job->serial != c->serial) { // the window has been resized in the meantime
+		free_blur_job(job);
+		return;
+	}
+	for (int i = 0; i < job->n; i++)
+		g_hash_table_insert(c->sprites, job->name[i], job->sprite[i]);
+	use_blur_sprites(c, glob.shown, glob.numviews);
+	g_free(job);
+}
+
+static gboolean on_blur_loaded(gpointer data)
+// called in the main thread when the blurred pictures are decoded by the thread data,
+// they are handed to the render thread like a new cache
+{
+	glob.blur_loaders = g_slist_remove(glob.blur_loaders, data);
+	struct blur_job *job = g_thread_join(data);
+	if (job->serial != glob.cache->serial) { // the window has been resized in the meantime
+		free_blur_job(job);
+		return FALSE;
+	}
+	glob.cache->blur = 2;
+	g_mutex_lock(&glob.lock);
+	if (glob.next_blur != 0) // never used
+		free_blur_job(glob.next_blur);
+	glob.next_blur = job;
+	g_mutex_unlock(&glob.lock);
+	request_render(ALL_VIEWS);
+	return FALSE;
+}
+
+static gpointer load_blur(gpointer data)
+{
+	struct blur_job *job = data;
+	for (int i = 0; i < job->n; i++)
+		job->sprite[i] = scale_picture(job->name[i], job->scale);
+	g_idle_add(on_blur_loaded, g_thread_self());
+	return job;
+}
+
+static void start_blur_loading()
+{
+	char s[32];
+	struct blur_job *job = g_new0(struct blur_job, 1);
+
+	glob.cache->blur = 1;
+	job->serial = glob.cache->serial;
+	job->scale = glob.cache->scale;
+	for (int i = 0; i < NUMANGLES; i++) {
+		sprintf(s,"reels/Reel1-0%dbl.png",i);
+		add_blur_name(job, s);
+		sprintf(s,"reels/hub%db.png",i);
+		add_blur_name(job, s);
+	}
+	for (int i = 0; i < glob.numviews; i++) {
+		const struct model *vm = glob.view[i].drive.model;
+		add_blur_name(job, vm->capstanb[0]);
+		add_blur_name(job, vm->capstanb[1]);
+		if (vm->numwheels > 0) {
+			add_blur_name(job, vm->wheelb[0]);
+			add_blur_name(job, vm->wheelb[1]);
+		}
+	}
+	glob.blur_loaders = g_slist_prepend(glob.blur_loaders, g_thread_new("blur", load_blur, job));
+}
+
+static void use_cache(struct cache *c)
+// called in the main thread when a new cache is ready, it is passed on to the render thread
+{
+	glob.building = 0;
+	glob.cache = c;
+	g_mutex_lock(&glob.lock);
+	if (glob.next_cache != 0) // never used
+		free_cache(glob.next_cache);
+	glob.next_cache = c;
+	g_mutex_unlock(&glob.lock);
+	// the window may have been resized again in the meantime
+	if (fabs(glob.scale * glob.fraction - c->scale) > 1e-6 * c->scale)
+		start_rebuild();
+	request_render(ALL_VIEWS);
+}
+
+static gboolean on_cache_built(gpointer data)
+{
+	struct cache *c = g_thread_join(glob.cache_loader);
+	glob.cache_loader = 0;
+	use_cache(c);
+	return FALSE;
+}
+
+struct build_job {
+  double scale;
+  int blur;
+};
+
+static gpointer build_cache(gpointer data)
+{
+	struct build_job *job = data;
+	struct cache *c = new_cache(job->scale, job->blur, glob.view, glob.numviews);
+	g_free(job);
+	g_idle_add(on_cache_built, 0);
+	return c;
+}
+
+static void start_rebuild()
+// build a new cache for the scale of the window, unless one is being built already
+{
+	if (glob.building)
+		return;
+	glob.building = 1;
+	struct build_job *job = g_new0(struct build_job, 1);
+	job->scale = glob.scale * glob.fraction;
+	job->blur = glob.cache->blur == 2;
+	if (glob.argSimclock) {
+		// the frames must not depend on when a thread finishes
+		use_cache(new_cache(job->scale, job->blur, glob.view, glob.numviews));
+		g_free(job);
+		return;
+	}
+	glob.cache_loader = g_thread_new("cache", build_cache, job);
+}
+
+int panel_main(const struct model *m, int argc, char *argv[])
+// m is the drive shown if no drives are specified on the command line
+{
+	GtkWidget *window;
+	GtkWidget *darea;
+	struct view *v = 0;
+	char *name = m ? m->name : "tapes";
+
+	blit_init();
+
+	// the jitter is different in every run, unless a seed is given
+	jitter_seed((unsigned)time(NULL));
+
+	glob.argFullscreen = 0;
+	glob.argFullv = 0;
+	glob.argShare = 0;
+	glob.argHttp = 0;
+	glob.argSound = 0;
+	glob.argSimclock = 0;
+	glob.argBench = 0;
+	ropt.lowmem = 0;
+	ropt.smooth = 0;
+	glob.fraction = 1.0;
+	glob.numviews = 0;
+	int firstArg = 1;
+
+	char s[32];
+
+	printf("%s version %s\n", name, VERSION);
+
+	// -unit1 and -label apply to the drive specified last
+	if (m != 0) {
+		v = &glob.view[glob.numviews++];
+		drive_init(&v->drive, m);
+	}
+
+	while (firstArg < argc) {
+		if (strcmp(argv[firstArg],"-full") == 0)
+			glob.argFullscreen = 1;
+		else if (strcmp(argv[firstArg],"-fullv") == 0)
+			glob.argFullv = 1;
+		else if (strcmp(argv[firstArg],"-lowmem") == 0)
+			ropt.lowmem = 1;
+		else if (strcmp(argv[firstArg],"-smooth") == 0)
+			ropt.smooth = 1;
+		else if (strcmp(argv[firstArg],"-share") == 0)
+			glob.argShare = 1;
+		else if (strcmp(argv[firstArg],"-seed") == 0) {
+			if (firstArg + 1 < argc)
+				jitter_seed(atoi(argv[firstArg++ + 1]));
+		}
+		else if (strcmp(argv[firstArg],"-simclock") == 0) {
+			glob.argSimclock = 1;
+			clock_simulate(0);
+		}
+		else if (strcmp(argv[firstArg],"-sound") == 0) {
+			if (firstArg + 1 < argc)
+				glob.argSound = argv[firstArg++ + 1];
+		}
+		else if (strcmp(argv[firstArg],"-bench") == 0) {
+			if (firstArg + 1 < argc)
+				glob.argBench = argv[firstArg++ + 1];
+		}
+		else if (strcmp(argv[firstArg],"-http") == 0) {
+			if (firstArg + 1 < argc)
+				glob.argHttp = argv[firstArg++ + 1];
+		}
+		else if (strcmp(argv[firstArg],"-fraction") == 0) {
+			if (firstArg + 1 < argc)
+				glob.fraction = atof(argv[firstArg++ + 1]);
+			if ((glob.fraction < 0.1) || (glob.fraction > 1.0)) {
+				printf("%s: -fraction must be between 0.1 and 1\n", name);
+				exit(1);
+			}
+		}
+		else if ((strcmp(argv[firstArg],"-unit1") == 0) && v)
+			v->drive.unit = 1;
+		else if ((strcmp(argv[firstArg],"-label") == 0) && v) {
+			if (firstArg + 1 < argc) {
+				v->drive.label = argv[firstArg++ + 1];
+			}
+		}
+		else if ((argv[firstArg][0] != '-') && (glob.numviews < MAX_DRIVES) &&
+			view_init(&glob.view[glob.numviews], argv[firstArg])) {
+			v = &glob.view[glob.numviews++];
+			// the drives specified on the command line replace the default drive
+			if ((m != 0) && (glob.numviews == 2)) {
+				glob.view[0] = glob.view[1];
+				glob.numviews = 1;
+				v = &glob.view[0];
+				m = 0;
+			}
+		}
+		else {
+		printf("%s: unknown argument %s\n", name, argv[firstArg]);
+		exit(1);
+		}
+	firstArg++;
+	}
+	if (glob.numviews == 0) {
+		printf("usage: %s [-full] [-fullv] [-lowmem] [-smooth] [-share] [-http [address:]port] [-sound aplay|file.wav] [-seed n] [-simclock] [-bench file] [-fraction f] model[:unit] [-unit1] [-label text] ...\n", name);
+		exit(1);
+	}
+
+	// place the drives next to each other
+	layout_views(glob.view, glob.numviews, &glob.width, &glob.height);
+	int image_width = glob.width;
+	int image_height = glob.height;
+
+	gtk_init(&argc, &argv);
+
+	window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
+	glob.window = window;
+
+	// set the background color
+	GdkColor color;
+	color.red   = 0;
+	color.green = 0;
+	color.blue  = 0;
+	gtk_widget_modify_bg(window, GTK_STATE_NORMAL, &color);
+
+	darea = gtk_drawing_area_new();
+	gtk_container_add(GTK_CONTAINER (window), darea);
+
+	g_signal_connect(G_OBJECT(darea), "draw",
+		G_CALLBACK(on_draw_event), NULL);
+	g_signal_connect(window, "destroy",
+		G_CALLBACK (gtk_main_quit), NULL);
+
+	gtk_window_set_position(GTK_WINDOW(window), GTK_WIN_POS_CENTER);
+
+	GdkScreen *screen = gtk_window_get_screen(GTK_WINDOW(window));
+	int screenWidth = gdk_screen_get_width(screen);
+	int screenHeight = gdk_screen_get_height(screen);
+	printf("Screen dimensions: %d x %d\n", screenWidth, screenHeight);
+
+	// the frames are never larger than the screen
+	if (glob.argShare)
+		glob.share = share_new((size_t)screenWidth * screenHeight * 4);
+	if (glob.argHttp != 0)
+		glob.stream = stream_new(glob.argHttp, on_stream_viewer);
+	if (glob.argSound != 0)
+		glob.sound = sound_new(glob.argSound);
+
+	if (glob.argFullscreen) {
+		// DISPLAY UNDECORATED FULL SCREEN WINDOW
+		gtk_window_set_decorated(GTK_WINDOW(window), FALSE);
+		gtk_window_fullscreen(GTK_WINDOW(window));
+		gtk_window_set_keep_above(GTK_WINDOW(window), FALSE);
+		glob.scale = (double) screenHeight / (double)image_height;
+		if (glob.scale * image_width > screenWidth)
+			glob.scale = (double) screenWidth / (double)image_width;
+		glob.xoffset = (int)((double)(screenWidth - image_width) / (2.0 * glob.scale));
+	}
+	else if (glob.argFullv) {
+		gtk_window_set_decorated(GTK_WINDOW(window), TRUE);
+		int h = screenHeight - BORDER;
+		int w = (int)((double)h * (double)image_width / (double)image_height);
+		if (w > screenWidth) {
+			w = screenWidth;
+			h = (int)((double)w * (double)image_height / (double)image_width);
+		}
+		gtk_window_set_default_size(GTK_WINDOW(window), w, h);
+		glob.scale = (double)w / image_width;
+		glob.xoffset = 0;
+	}
+
+	else {
+		// DISPLAY DECORATED WINDOW
+		gtk_window_set_decorated(GTK_WINDOW(window), TRUE);
+		glob.scale = 0.5;
+		if (glob.scale * image_width > screenWidth)
+			glob.scale = (double) screenWidth / (double)image_width;
+		gtk_window_set_default_size(GTK_WINDOW(window), (int)(image_width * glob.scale),
+			(int)(image_height * glob.scale));
+		glob.xoffset = 0;
+	}
+
+	// decode the pictures and scale them to the display, with a simulated clock
+	// the blurred ones too, as they would otherwise appear when loaded
+	glob.cache = glob.draw_cache = new_cache(glob.scale * glob.fraction, glob.argSimclock,
+		glob.view, glob.numviews);
+
+	gtk_window_set_title(GTK_WINDOW(window), name);
+
+	g_signal_connect(G_OBJECT(window), "button-press-event", G_CALLBACK(on_button_click_event), NULL);
+	g_signal_connect(G_OBJECT(window), "key_press_event", G_CALLBACK(on_key_press), NULL);
+
+	// Watch the status file, so that the timer can be stopped while all drives are idle
+	GFile *statusFile = g_file_new_for_path("/tmp/tu56status");
+	glob.monitor = g_file_monitor_file(statusFile, G_FILE_MONITOR_NONE, NULL, NULL);
+	g_object_unref(statusFile);
+	if (glob.monitor != 0) {
+		g_file_monitor_set_rate_limit(glob.monitor, TIME_INTERVAL);
+		g_signal_connect(G_OBJECT(glob.monitor), "changed", G_CALLBACK(on_status_changed), window);
+	}
+
+	glob.numworkers = g_get_num_processors() - 1;
+	if (glob.numworkers > MAX_WORKERS)
+		glob.numworkers = MAX_WORKERS;
+	for (int i = 0; i < glob.numworkers; i++)
+		glob.workers[i] = g_thread_new("tiles", worker_loop, 0);
+	glob.render_thread = g_thread_new("render", render_loop, 0);
+
+	// Add timer event
+	start_timer(window);
+
+	gtk_widget_show_all(window);
+
+	// the startup is not measured
+	if (glob.argBench != 0) {
+		glob.bench = bench_new(glob.argBench);
+		g_unix_signal_add(SIGTERM, on_signal, 0);
+		g_unix_signal_add(SIGINT, on_signal, 0);
+	}
+
+	gtk_main();
+
+	// every thread has ended before anything it may use is freed, the pictures
+	// still being decoded are not used any more
+	if (glob.cache_loader != 0)
+		free_cache(g_thread_join(glob.cache_loader));
+	while (glob.blur_loaders != 0) {
+		free_blur_job(g_thread_join(glob.blur_loaders->data));
+		glob.blur_loaders = g_slist_delete_link(glob.blur_loaders, glob.blur_loaders);
+	}
+	g_mutex_lock(&glob.lock);
+	glob.quit = 1;
+	g_cond_signal(&glob.wake);
+	g_mutex_unlock(&glob.lock);
+	g_thread_join(glob.render_thread);
+	g_mutex_lock(&glob.pool_lock);
+	glob.pool_quit = 1;
+	g_cond_broadcast(&glob.pool_start);
+	g_mutex_unlock(&glob.pool_lock);
+	for (int i = 0; i < glob.numworkers; i++)
+		g_thread_join(glob.workers[i]);
+	g_free(glob.tiles);
+	for (int i = 0; i < 2; i++)
+		if (glob.frame[i] != 0)
+			cairo_surface_destroy(glob.frame[i]);
+	if (glob.next_blur != 0)
+		free_blur_job(glob.next_blur);
+	if (glob.next_cache != 0)
+		free_cache(glob.next_cache);
+	free_cache(glob.draw_cache);
+	if (glob.share != 0)
+		share_free(glob.share);
+	if (glob.stream != 0)
+		stream_free(glob.stream);
+	if (glob.sound != 0)
+		sound_free(glob.sound);
+	if (glob.bench != 0)
+		bench_free(glob.bench);
+
+	return 0;
+}
@@ -0,0 +1,399 @@
+/*
+ * render.c
+ *
+ * Composition of the drives into frames, shared by the front panels
+ * and by the offline exporter
+ *
+ * for the Raspberry Pi and other Linux systems
+ *
+ * Copyright 2019  rricharz
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "render.h"
+
+struct render_options ropt;
+
+static int serial;			// of the last cache built
+
+int view_init(struct view *v, char *spec)
+// initialize a drive specified as model[:unit], return 0 if the model is not known
+{
+	char name[32];
+	int unit = 0;
+	const char *colon = strchr(spec, ':');
+	int n = colon ? colon - spec : strlen(spec);
+	if (n >= sizeof(name))
+		return 0;
+	strncpy(name, spec, n);
+	name[n] = 0;
+	if (colon)
+		unit = atoi(colon + 1) != 0;
+	const struct model *m = find_model(name);
+	if (m == 0)
+		return 0;
+	drive_init(&v->drive, m);
+	v->drive.unit = unit;
+	return 1;
+}
+
+void layout_views(struct view *views, int n, int *width, int *height)
+// place the drives next to each other, return the size of all drives in dots
+{
+	*width = 0;
+	*height = 0;
+	for (int i = 0; i < n; i++) {
+		struct view *v = &views[i];
+		png_size(v->drive.model->image, &v->width, &v->height);
+		v->x = *width;
+		*width += v->width;
+		if (v->height > *height) *height = v->height;
+	}
+}
+
+static cairo_surface_t* readpng(char* s)
+{
+	cairo_surface_t *t = cairo_image_surface_create_from_png(s);
+	if ((t == 0) || cairo_surface_status(t)) {
+		printf("Cannot load %s\n",s);
+		exit(1);
+	}
+	return t;
+}
+
+void png_size(char *s, int *width, int *height)
+// get the size of a picture from its png header, without decoding it
+{
+	unsigned char h[24];
+	FILE *f = fopen(s, "r");
+	if ((f == 0) || (fread(h, 1, 24, f) != 24) || (memcmp(h + 12, "IHDR", 4) != 0)) {
+		printf("Cannot load %s\n",s);
+		exit(1);
+	}
+	fclose(f);
+	*width = (h[16] << 24) | (h[17] << 16) | (h[18] << 8) | h[19];
+	*height = (h[20] << 24) | (h[21] << 16) | (h[22] << 8) | h[23];
+}
+
+struct sprite *scale_picture(char *s, double display_scale)
+// decode a picture and scale it to the display, can be called from any thread
+{
+	char name[256];
+	cairo_surface_t *t = 0;
+	int level;
+	struct sprite *sp;
+
+	// use the smallest reduced picture which is not smaller than the display
+	for (level = PYRAMID_LEVELS; level > 1; level /= 2) {
+		if (display_scale * level > 1.0 + 1e-6)
+			continue;
+		snprintf(name, sizeof(name), "%s/%d/%s", PYRAMID_DIR, level, s);
+		if (access(name, R_OK) == 0) {
+			t = readpng(name);
+			break;
+		}
+	}
+	if (t == 0) // full size, if no reduced pictures have been made
+		t = readpng(s);
+
+	double scale = display_scale * level;
+	int w = (int)ceil(cairo_image_surface_get_width(t) * scale);
+	int h = (int)ceil(cairo_image_surface_get_height(t) * scale);
+	cairo_surface_t *scaled = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, w, h);
+	cairo_t *cr = cairo_create(scaled);
+	cairo_scale(cr, scale, scale);
+	cairo_set_source_surface(cr, t, 0, 0);
+	cairo_pattern_set_filter(cairo_get_source(cr), CAIRO_FILTER_GOOD);
+	cairo_paint(cr);
+	cairo_destroy(cr);
+	cairo_surface_destroy(t);
+	sp = sprite_new(scaled);
+	if (ropt.lowmem)
+		sprite_reduce(sp);
+	return sp;
+}
+
+static struct sprite *load_sprite(struct cache *c, char *s)
+// return the scaled sprite of a picture, decoded only once for each cache
+{
+	struct sprite *sp = g_hash_table_lookup(c->sprites, s);
+	if (sp == 0) {
+		sp = scale_picture(s, c->scale);
+		g_hash_table_insert(c->sprites, g_strdup(s), sp);
+	}
+	return sp;
+}
+
+void use_blur_sprites(struct cache *c, const struct view *views, int n)
+// replace the sharp pictures by the blurred pictures, if they are loaded
+{
+	char s[32];
+	for (int i = 0; i < NUMANGLES; i++) {
+		sprintf(s,"reels/Reel1-0%dbl.png",i);
+		c->reel1bl[i] = g_hash_table_lookup(c->sprites, s);
+		sprintf(s,"reels/hub%db.png",i);
+		c->hubb[i] = g_hash_table_lookup(c->sprites, s);
+	}
+	for (int i = 0; i < n; i++) {
+		struct view_sprites *vs = &c->view[i];
+		const struct model *vm = views[i].drive.model;
+		vs->capstanb[0] = g_hash_table_lookup(c->sprites, vm->capstanb[0]);
+		vs->capstanb[1] = g_hash_table_lookup(c->sprites, vm->capstanb[1]);
+		if (vm->numwheels > 0) {
+			vs->wheelb[0] = g_hash_table_lookup(c->sprites, vm->wheelb[0]);
+			vs->wheelb[1] = g_hash_table_lookup(c->sprites, vm->wheelb[1]);
+		}
+	}
+}
+
+struct cache *new_cache(double scale, int blur, const struct view *views, int n)
+// decode all pictures and scale them, can be called from any thread
+// without blur, the sharp pictures are used for the blurred ones until these are loaded
+{
+	char s[32];
+	struct cache *c = g_new0(struct cache, 1);
+
+	c->scale = scale;
+	c->serial = g_atomic_int_add(&serial, 1);
+	c->sprites = g_hash_table_new_full(g_str_hash, g_str_equal,
+		g_free, (GDestroyNotify) sprite_free);
+	png_size("reels/Reel1-00.png", &c->reelw, &c->reelh);
+	for (int i = 0; i < NUMANGLES; i++) {
+		sprintf(s,"reels/Reel1-0%d.png",i);
+		c->reel1[i] = c->reel1bl[i] = load_sprite(c, s);
+		sprintf(s,"reels/hub%d.png",i);
+		c->hub[i] = c->hubb[i] = load_sprite(c, s);
+		if (blur) {
+			sprintf(s,"reels/Reel1-0%dbl.png",i);
+			load_sprite(c, s);
+			sprintf(s,"reels/hub%db.png",i);
+			load_sprite(c, s);
+		}
+	}
+	for (int i = 0; i < n; i++) {
+		struct view_sprites *vs = &c->view[i];
+		const struct model *vm = views[i].drive.model;
+		vs->image = load_sprite(c, vm->image);
+		vs->capstan = vs->capstanb[0] = vs->capstanb[1] = load_sprite(c, vm->capstan);
+		if (vm->numwheels > 0)
+			vs->wheel = vs->wheelb[0] = vs->wheelb[1] = load_sprite(c, vm->wheel);
+		if (blur) {
+			load_sprite(c, vm->capstanb[0]);
+			load_sprite(c, vm->capstanb[1]);
+			if (vm->numwheels > 0) {
+				load_sprite(c, vm->wheelb[0]);
+				load_sprite(c, vm->wheelb[1]);
+			}
+		}
+	}
+	if (blur) {
+		use_blur_sprites(c, views, n);
+		c->blur = 2;
+	}
+	return c;
+}
+
+void free_cache(struct cache *c)
+{
+	g_hash_table_destroy(c->sprites);
+	g_free(c);
+}
+
+static void draw_column(cairo_t *cr, int ox, const struct model *m, const struct column *c, double delta)
+// draw the tape in a vacuum column
+{
+	int x = c->x + ox;
+	double y = c->y + c->dir * delta;
+
+	if (m->columnStyle == COLUMN_LOOP) {
+		cairo_move_to(cr, x + c->r, c->topr);
+		cairo_line_to(cr, x + c->r, y);
+		if (c->dir > 0)
+			cairo_arc(cr, x, y, c->r, 0.0, M_PI);
+		else
+			cairo_arc_negative(cr, x, y, c->r, 0.0, M_PI);
+		cairo_line_to(cr, x - c->r, c->topl);
+	}
+	else if (c->dir > 0)
+		cairo_arc(cr, x, y, c->r, 0.1 * M_PI, 0.9 * M_PI);
+	else
+		cairo_arc(cr, x, y, c->r, 1.1 * M_PI, 1.9 * M_PI);
+	cairo_stroke(cr);
+}
+
+void render_view(struct frame *f, const struct cache *c, int xoffset, const struct view *v,
+	const struct view_sprites *vs, const cairo_rectangle_int_t *clip)
+// compose the part of a drive within the clip rectangle into the frame,
+// called concurrently for different clip rectangles
+{
+	const struct drive *d = &v->drive;
+	const struct model *m = d->model;
+	int ox = v->x + xoffset;
+	int reel1x = m->reel1x + ox;
+	int reel2x = m->reel2x + ox;
+
+	// the reels are drawn later, so the drive is not drawn where they are opaque
+	int index1 = d->angle1 * NUMANGLES / 360;
+	int index2 = d->angle2 * NUMANGLES / 360;
+	struct sprite *const *reels1 = (d->actual_speed1 != 0) ? c->reel1bl : c->reel1;
+	struct sprite *const *reels2 = (d->actual_speed2 != 0) ? c->reel1bl : c->reel1;
+	struct sprite *const *hubs = (d->actual_speed2 != 0) ? c->hubb : c->hub;
+	int next1 = (index1 + 1) % NUMANGLES;
+	int next2 = (index2 + 1) % NUMANGLES;
+
+	// with -smooth, the two nearest angles are cross-faded, w is the weight of the next angle
+	int w1 = 0, w2 = 0;
+	if (ropt.smooth) {
+		w1 = (int)((d->angle1 * NUMANGLES / 360 - index1) * 256);
+		w2 = (int)((d->angle2 * NUMANGLES / 360 - index2) * 256);
+	}
+
+	struct occluder o[2] = {
+		{ reels1[index1], px(c, reel1x), px(c, m->reel1y), w1 ? reels1[next1] : 0 },
+		{ reels2[index2], px(c, reel2x), px(c, m->reel2y), w2 ? reels2[next2] : 0 }
+	};
+
+	// draw the drive
+	blit_occluded(f, vs->image, px(c, ox), 0, clip, o, 2);
+
+	// draw the capstan and the wheels
+	if (d->requested_speed1 != 0.0)
+		blit(f, vs->capstanb[v->capstan_index], px(c, m->capstanx + ox), px(c, m->capstany), clip, BLIT_OVER);
+	else
+		blit(f, vs->capstan, px(c, m->capstanx + ox), px(c, m->capstany), clip, BLIT_OVER);
+	for (int i = 0; i < m->numwheels; i++) {
+		if (d->requested_speed1 != 0.0)
+			blit(f, vs->wheelb[v->capstan_index], px(c, m->wheelx[i] + ox), px(c, m->wheely[i]),
+				clip, BLIT_OVER);
+		else
+			blit(f, vs->wheel, px(c, m->wheelx[i] + ox), px(c, m->wheely[i]), clip, BLIT_OVER);
+	}
+
+	// draw the reels
+	blit_mix(f, reels1[index1], reels1[next1], w1, o[0].x, o[0].y, clip);
+	blit_mix(f, reels2[index2], reels2[next2], w2, o[1].x, o[1].y, clip);
+
+	// draw the hub
+
+	blit_mix(f, hubs[index2], hubs[next2], w2, px(c, reel2x + HUB_OFFSET), px(c, m->reel2y + HUB_OFFSET),
+		clip);
+
+	// the tape, the leds and the label are drawn by cairo,
+	// into a surface of its own for each tile
+
+	int bpp = (f->format == CAIRO_FORMAT_RGB16_565) ? 2 : 4;
+	unsigned char *data = (f->format == CAIRO_FORMAT_RGB16_565) ?
+		(unsigned char *)f->data16 : (unsigned char *)f->data;
+	cairo_surface_t *tile = cairo_image_surface_create_for_data(
+		data + clip->y * f->stride * bpp + clip->x * bpp,
+		f->format, clip->width, clip->height, f->stride * bpp);
+	cairo_t *cr = cairo_create(tile);
+	cairo_translate(cr, -clip->x, -clip->y);
+	cairo_scale(cr,c->scale,c->scale);
+
+	// draw the tape on the reels
+
+	int w = c->reelw;
+	int h = c->reelh;
+
+	cairo_set_source_rgba(cr, 0.2, 0.1, 0.0, 0.3);
+
+	int lw = d->radius1 - MIN_TRADIUS;
+	cairo_set_line_width(cr, lw);
+	cairo_arc(cr, reel1x  + w / 2, m->reel1y + h / 2, d->radius1 - (lw / 2), 0.0, 2.0 * M_PI);
+	cairo_stroke(cr);
+
+	lw = d->radius2 - MIN_TRADIUS;
+	// printf("w = %d, radius2=%d, min=%d, lw=%d\n", w, d->radius2, MIN_TRADIUS, lw);
+	cairo_set_line_width(cr, lw);
+	cairo_arc(cr, reel2x  + w / 2, m->reel2y + h / 2, d->radius2 - (lw / 2), 0.0, 2.0 * M_PI);
+	cairo_stroke(cr);
+
+	// draw the tape in the vacuum columns
+
+	cairo_set_source_rgba(cr, 0.2, 0.1, 0.0, 1.0);
+	cairo_set_line_width(cr, 2);
+	draw_column(cr, ox, m, &m->vc1, d->delta_vc1);
+	draw_column(cr, ox, m, &m->vc2, d->delta_vc2);
+
+	// draw the red leds
+
+	if (m->numbuttons > 0) {
+		cairo_set_source_rgb(cr, 1.0, 0.3, 0.3);
+		cairo_set_line_width(cr, 1);
+		cairo_arc(cr, m->led_power_x + ox, m->led_y, m->led_radius, 0.0, 2.0 * M_PI);
+		cairo_fill(cr);
+
+		if (d->buttonState[BUTTON_ONLINE]) {
+			cairo_arc(cr, m->led_online_x + ox, m->led_y, m->led_radius, 0.0, 2.0 * M_PI);
+			cairo_fill(cr);
+		}
+		if (d->position == 0) {
+			cairo_arc(cr, m->led_bot_x + ox, m->led_y, m->led_radius, 0.0, 2.0 * M_PI);
+			cairo_fill(cr);
+		}
+	}
+
+	// draw a label onto the removable reel
+
+	cairo_text_extents_t extent;
+
+	if (d->label[0] != 0) {
+
+		if (d->actual_speed2 != 0) {
+			lw = LABELH * 1.2;
+			cairo_set_line_width(cr, lw);
+			cairo_set_source_rgba(cr, 0.3, 0.3, 0.8,0.08);
+			cairo_arc(cr, reel2x  + w / 2, m->reel2y + h / 2, LABELP - LABELH / 2.0,
+				(-80.0 +index2 * 36.0) * M_PI / 180.0,
+				(80.0 + index2 * 36.0) * M_PI / 180.0);
+			cairo_set_source_rgba(cr, 0.3, 0.3, 0.8,0.15);
+			cairo_stroke(cr);
+			cairo_arc(cr, reel2x  + w / 2, m->reel2y + h / 2, LABELP - LABELH / 2.0,
+				(-50.0 +index2 * 36.0) * M_PI / 180.0,
+				(50.0 + index2 * 36.0) * M_PI / 180.0);
+			cairo_stroke(cr);
+		}
+		else {
+			cairo_set_source_rgb(cr, 0.3, 0.3, 0.8);
+			cairo_set_line_width (cr, 2);
+			cairo_translate(cr, reel2x  + w / 2 , m->reel2y + h / 2);
+			cairo_rotate(cr, (index2 * 36.0) * M_PI / 180.0);
+			cairo_rectangle (cr,  -LABELW / 2 , - LABELP, LABELW, LABELH);
+			cairo_stroke_preserve(cr);
+			cairo_fill(cr);
+			cairo_set_source_rgb(cr, 0.0, 0.0, 0.0);
+			cairo_select_font_face(cr, "Purisa", CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_NORMAL);
+			cairo_set_font_size(cr, 12);
+			cairo_text_extents(cr, d->label, &extent);
+			// printf("extent: %0.0f,%0.0f\n", extent.width, extent.height);
+			cairo_move_to(cr, - extent.width / 2.0, - LABELP + (LABELH + extent.height) / 2.0);
+			cairo_show_text(cr, d->label);
+			cairo_stroke (cr);
+		}
+	}
+
+	cairo_destroy(cr);
+	cairo_surface_destroy(tile);
+}
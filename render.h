@@ -0,0 +1,94 @@
+/*
+ * render.h
+ *
+ * Composition of the drives into frames, shared by the front panels
+ * and by the offline exporter
+ *
+ * for the Raspberry Pi and other Linux systems
+ *
+ * Copyright 2019  rricharz
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ *
+ */
+
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <math.h>
+#include <glib.h>
+#include <cairo.h>
+
+#include "tape.h"
+#include "blit.h"
+
+// One view shows one drive in the window.
+
+struct view {
+  struct drive drive;
+  int x;				// left edge of the drive in dots
+  int width, height;			// size of the drive in dots
+  int moving;
+  int capstan_index;
+};
+
+// Pictures are decoded and scaled to the display once, as sprites
+// shared by all views which use them. When the window is resized, a new cache
+// of sprites is built by a separate thread, and the frames composed with the
+// previous cache are scaled by cairo until the new cache is ready.
+
+struct view_sprites {
+  struct sprite *image;
+  struct sprite *capstan, *capstanb[2];
+  struct sprite *wheel, *wheelb[2];
+};
+
+struct cache {
+  double scale;
+  int serial;
+  GHashTable *sprites;			// scaled sprites by file name
+  int blur;				// blurred pictures: 0 not loaded, 1 loading, 2 loaded
+  int reelw, reelh;			// size of the reel pictures in dots
+  struct sprite *reel1[NUMANGLES], *reel1bl[NUMANGLES];
+  struct sprite *hub[NUMANGLES], *hubb[NUMANGLES];
+  struct view_sprites view[MAX_DRIVES];
+};
+
+struct render_options {
+  int lowmem;				// 16 bit sprites and frame
+  int smooth;				// cross-fade the pictures of adjacent angles
+};
+
+extern struct render_options ropt;
+
+static inline int px(const struct cache *c, double x)
+// convert dots to pixels in a frame composed with the cache
+{
+	return (int)floor(x * c->scale + 0.5);
+}
+
+int view_init(struct view *v, char *spec);
+void layout_views(struct view *views, int n, int *width, int *height);
+void png_size(char *s, int *width, int *height);
+struct sprite *scale_picture(char *s, double display_scale);
+struct cache *new_cache(double scale, int blur, const struct view *views, int n);
+void use_blur_sprites(struct cache *c, const struct view *views, int n);
+void free_cache(struct cache *c);
+void render_view(struct frame *f, const struct cache *c, int xoffset, const struct view *v,
+	const struct view_sprites *vs, const cairo_rectangle_int_t *clip);
+
+#endif
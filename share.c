@@ -0,0 +1,151 @@
+/*
+ * share.c
+ *
+ * Publishes the composed frames in shared memory, so that other programs
+ * on the same machine can read them without copies and without X
+ *
+ * for the Raspberry Pi and other Linux systems
+ *
+ * Copyright 2019  rricharz
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <glib.h>
+
+#include "share.h"
+
+struct share {
+  int fd;
+  size_t size;				// of the mapping
+  struct share_header *header;
+  char path[64];			// of the memfd in /proc, SHARE_LINK points to it
+};
+
+static int link_is(const char *path)
+// SHARE_LINK points to path
+{
+	char target[64];
+	ssize_t n = readlink(SHARE_LINK, target, sizeof(target) - 1);
+	if (n < 0)
+		return 0;
+	target[n] = 0;
+	return strcmp(target, path) == 0;
+}
+
+struct share *share_new(size_t slot_size)
+// create the shared frames, slot_size is the size of the largest frame, return 0 on failure
+{
+	struct stat st;
+	long page = sysconf(_SC_PAGESIZE);
+	size_t header_size = (sizeof(struct share_header) + page - 1) / page * page;
+	slot_size = (slot_size + page - 1) / page * page;
+
+	int fd = memfd_create("tu56frames", MFD_CLOEXEC);
+	if (fd < 0) {
+		printf("Cannot create shared frames\n");
+		return 0;
+	}
+	size_t size = header_size + SHARE_SLOTS * slot_size;
+	if (ftruncate(fd, size) != 0) {
+		printf("Cannot allocate %ld bytes of shared frames\n", (long)size);
+		close(fd);
+		return 0;
+	}
+	void *p = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (p == MAP_FAILED) {
+		close(fd);
+		return 0;
+	}
+
+	struct share *s = g_new0(struct share, 1);
+	s->fd = fd;
+	s->size = size;
+	s->header = p;
+	s->header->magic = SHARE_MAGIC;
+	s->header->version = SHARE_VERSION;
+	s->header->slots = SHARE_SLOTS;
+	s->header->slot_size = slot_size;
+	s->header->latest = -1;
+	for (int i = 0; i < SHARE_SLOTS; i++)
+		s->header->slot[i].offset = header_size + i * slot_size;
+
+	// readers open the memfd of this process by its name in /proc, a link to the memfd
+	// of another panel which is still running is left alone, a stale one is replaced
+	snprintf(s->path, sizeof(s->path), "/proc/%d/fd/%d", (int)getpid(), fd);
+	if ((lstat(SHARE_LINK, &st) == 0) && (stat(SHARE_LINK, &st) != 0))
+		unlink(SHARE_LINK);
+	if (symlink(s->path, SHARE_LINK) != 0)
+		printf("Cannot create %s, another panel may share its frames\n", SHARE_LINK);
+	return s;
+}
+
+void share_begin(struct share *s, int slot)
+// mark the frame in a slot as being composed
+{
+	struct share_slot *sl = &s->header->slot[slot];
+	g_atomic_int_set((gint *)&sl->seq, s->header->seq + 1);
+}
+
+cairo_surface_t *share_surface(struct share *s, int slot, cairo_format_t format,
+	int width, int height)
+// create a surface for a frame in a slot, return 0 if the frame is too large
+{
+	int stride = cairo_format_stride_for_width(format, width);
+	if ((size_t)stride * height > s->header->slot_size)
+		return 0;
+	struct share_slot *sl = &s->header->slot[slot];
+	unsigned char *data = (unsigned char *)s->header + sl->offset;
+	share_begin(s, slot);
+	memset(data, 0, s->header->slot_size); // the margins around the drives are black
+	sl->format = format;
+	sl->width = width;
+	sl->height = height;
+	sl->stride = stride;
+	return cairo_image_surface_create_for_data(data, format, width, height, stride);
+}
+
+void share_publish(struct share *s, int slot, const cairo_rectangle_int_t *damage)
+// mark the frame in a slot as complete and make it the newest
+{
+	struct share_slot *sl = &s->header->slot[slot];
+	sl->damage_x = damage->x;
+	sl->damage_y = damage->y;
+	sl->damage_width = damage->width;
+	sl->damage_height = damage->height;
+	s->header->seq += 2;
+	g_atomic_int_set((gint *)&sl->seq, s->header->seq);
+	g_atomic_int_set((gint *)&s->header->latest, slot);
+}
+
+void share_free(struct share *s)
+{
+	if (link_is(s->path))
+		unlink(SHARE_LINK);
+	munmap(s->header, s->size);
+	close(s->fd);
+	g_free(s);
+}
@@ -0,0 +1,81 @@
+/*
+ * share.h
+ *
+ * Publishes the composed frames in shared memory, so that other programs
+ * on the same machine can read them without copies and without X
+ *
+ * for the Raspberry Pi and other Linux systems
+ *
+ * Copyright 2019  rricharz
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ *
+ */
+
+#ifndef SHARE_H
+#define SHARE_H
+
+#include <stdint.h>
+#include <cairo.h>
+
+// The frames are composed directly into a memfd, which is reachable as SHARE_LINK
+// while the panel runs. The link belongs to the first panel started with -share. It starts with a share_header, followed by SHARE_SLOTS
+// frames at the offsets given in the slots. A reader maps the file read only and:
+//
+//   1. reads latest, the slot of the newest frame, and the seq of this slot
+//   2. if seq is odd, the slot is being written, start again
+//   3. reads the pixels
+//   4. if seq of the slot has changed in the meantime, the pixels are not valid
+//
+// seq increases by 2 for every frame. The damage rectangle is the part of the frame
+// which differs from the previous frame. All numbers are in host byte order.
+
+#define SHARE_LINK		"/tmp/tu56frames"
+#define SHARE_MAGIC		0x37375554	// "TU77"
+#define SHARE_VERSION		1
+#define SHARE_SLOTS		2		// the two frames of the render thread
+
+struct share_slot {
+  int32_t seq;				// odd while the frame is composed
+  int32_t format;			// CAIRO_FORMAT_RGB24 or CAIRO_FORMAT_RGB16_565
+  int32_t width, height;		// in pixels
+  int32_t stride;			// in bytes
+  int32_t damage_x, damage_y;		// changed since the previous frame
+  int32_t damage_width, damage_height;
+  uint32_t offset;			// of the pixels from the start of the file
+};
+
+struct share_header {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t slots;
+  uint32_t slot_size;			// maximal size of a frame in bytes
+  int32_t latest;			// slot of the newest frame, -1 if none
+  int32_t seq;				// of the newest frame
+  struct share_slot slot[SHARE_SLOTS];
+};
+
+struct share;
+
+struct share *share_new(size_t slot_size);
+cairo_surface_t *share_surface(struct share *s, int slot, cairo_format_t format,
+	int width, int height);
+void share_begin(struct share *s, int slot);
+void share_publish(struct share *s, int slot, const cairo_rectangle_int_t *damage);
+void share_free(struct share *s);
+
+#endif
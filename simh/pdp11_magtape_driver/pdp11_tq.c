@@ -271,6 +271,8 @@ int32 tq_typ = INIT_TYPE;                               /* device type */
 
 /* constants, variables and functions for timed operations and status bytes file */
 
+#include <time.h>
+
 #define TSTATE_ONLINE		1		// Turns the online light on
 #define TSTATE_DRIVE1		2		// Selects drive 0 or 1
 #define TSTATE_BACKWARDS	4		// Sets the direction
@@ -278,17 +280,16 @@ int32 tq_typ = INIT_TYPE;                               /* device type */
 #define TSTATE_READ		16		// Spins the reels
 #define TSTATE_WRITE		32		// Turns the write light on and spins the reels
 
-int32 tq_savpkt;
-int32 tq_savedpos;
-int32 tq_status;
-
 FILE *tq_statusFile = 0;
+uint32 tq_statusSeq = 0;                                /* records written */
 
-void tq_setStatus()
-// set the status bits in the status file
+void tq_setStatus(int32 status, int32 pos)
+// set the status bits and the position of a unit in the status file
 // if status file is accessible
+// the record carries the time in usec and a sequence number, to measure the latency of the panel
 {	
 	char *fname = "/tmp/tu56status";
+	struct timespec ts;
 	
 	if (tq_statusFile == 0) {
 		tq_statusFile = fopen(fname, "w");
@@ -296,8 +297,10 @@ void tq_setStatus()
 
 	if (tq_statusFile != 0) {
 		fseek(tq_statusFile,0L,SEEK_SET);
-		// putc(32 + tq_status,tq_statusFile);
-		fprintf(tq_statusFile,"%c%d\n", 32 + tq_status, tq_savedpos); 
+		// putc(32 + status,tq_statusFile);
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		fprintf(tq_statusFile,"%c%d %lld %u\n", 32 + status, pos,
+			(long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000, ++tq_statusSeq);
 		fflush(tq_statusFile);
 	}
 }
@@ -427,6 +430,7 @@ t_bool tq_mot_end (UNIT *uptr, uint32 flg, uint16 sts, uint32 rsiz);
 void tq_putr (int32 pkt, uint32 cmd, uint32 flg, uint16 sts, uint16 lnt, uint16 typ);
 void tq_putr_unit (int16 pkt, UNIT *uptr, uint16 lu, t_bool all);
 void tq_setf_unit (int16 pkt, UNIT *uptr);
+void tq_initStatus (UNIT *uptr, uint32 cmd, uint16 lu);
 uint32 tq_efl (UNIT *uptr);
 void tq_init_int (void);
 void tq_ring_int (struct uq_ring *ring);
@@ -590,6 +594,8 @@ struct tq_req_results {           /* intermediate State during tape motion comma
     uint32 skrec;
     t_mtrlnt tbc;
     int32 objupd;
+    int32 savedpos;                                     /* position at the start, for realistic timing */
+    int32 status;                                       /* status bits of the command */
     uint8 tqxb[TQ_MAXFR];
     };
 
@@ -790,23 +796,6 @@ if ((pkt == 0) && tq_pip) {                             /* polling? */
                     tq_pkt[pkt].d[RW_BCH], tq_pkt[pkt].d[RW_BCL],
                     tq_pkt[pkt].d[RW_BAH], tq_pkt[pkt].d[RW_BAL]);
 
-// prepare status byte and realistic timing                    
-	tq_savpkt = pkt;
-	if (up) {
-	    tq_savedpos = up->pos;
-        }
-    else
-		tq_savedpos = 0;
-	tq_status = TSTATE_ONLINE;
-	if (tq_pkt[pkt].d[CMD_UN] == 1) tq_status |= TSTATE_DRIVE1;
-	switch (tq_pkt[pkt].d[CMD_OPC]) {
-	    case OP_POS: tq_status |= TSTATE_SEEK; break;
-	    case OP_RD:  tq_status |= TSTATE_READ; break;  
-	    case OP_WR:  tq_status |= TSTATE_WRITE; break;
-	    case OP_CMP: tq_status |= TSTATE_READ; break;
-	    case OP_WTM: tq_status |= TSTATE_WRITE; break;
-	}
-
         if (GETP (pkt, UQ_HCTC, TYP) != UQ_TYP_SEQ)     /* seq packet? */
             return tq_fatal (PE_PIE);                   /* no, term thread */
         cnid = GETP (pkt, UQ_HCTC, CID);                /* get conn ID */
@@ -868,6 +857,8 @@ uint32 flg = GETP (pkt, CMD_OPC, FLG);                  /* flags */
 uint32 mdf = tq_pkt[pkt].d[CMD_MOD];                    /* modifier */
 uint16 lu = tq_pkt[pkt].d[CMD_UN];                      /* unit # */
 UNIT *uptr;
+struct tq_req_results *res;
+int32 savedpos, status;
 
 sim_debug(DBG_TRC, &tq_dev, "tq_mscp\n");
 
@@ -894,7 +885,16 @@ else {                                                  /* valid cmd */
 /*          uptr->flags = uptr->flags & ~UNIT_CDL; */
         if ((mdf & MD_CSE) && (uptr->flags & UNIT_SXC)) /* clr ser exc? */
             uptr->flags = uptr->flags & ~UNIT_SXC;
+        res = (struct tq_req_results *)uptr->results;
+        savedpos = res->savedpos;                       /* of a motion in progress */
+        status = res->status;
         memset (uptr->results, 0, sizeof (struct tq_req_results)); /* init request state */
+        if ((tq_cmf[cmd] & CMF_SEQ) && (uptr->cpkt == 0)) /* starts a command? */
+            tq_initStatus (uptr, cmd, lu);              /* status byte and realistic timing */
+        else {                                          /* e.g. GCS during a motion */
+            res->savedpos = savedpos;
+            res->status = status;
+            }
         }
     switch (cmd) {
 
@@ -1332,6 +1332,25 @@ if (tq_cmf[cmd] & CMF_WR) {                             /* write op? */
 return ST_SUC;                                          /* success! */
 }
 
+/* Status byte and realistic timing, kept for each unit, so that the drives
+   move independently of each other */
+
+void tq_initStatus (UNIT *uptr, uint32 cmd, uint16 lu)
+{
+	struct tq_req_results *res = (struct tq_req_results *)uptr->results;
+
+	res->savedpos = uptr->pos;
+	res->status = TSTATE_ONLINE;
+	if (lu == 1) res->status |= TSTATE_DRIVE1;
+	switch (cmd) {
+	    case OP_POS: res->status |= TSTATE_SEEK; break;
+	    case OP_RD:  res->status |= TSTATE_READ; break;  
+	    case OP_WR:  res->status |= TSTATE_WRITE; break;
+	    case OP_CMP: res->status |= TSTATE_READ; break;
+	    case OP_WTM: res->status |= TSTATE_WRITE; break;
+	}
+}
+
 /* Unit service for motion commands */
 
 /* I/O completion callback */
@@ -1346,22 +1365,17 @@ void tq_io_complete (UNIT *uptr, t_stat status)
 	res->io_status = status;
 	res->io_complete = 1;
 
-	/* Reschedule for the appropriate delay */
-	UNIT *up = tq_getucb (tq_pkt[tq_savpkt].d[CMD_UN]);
-	if (up) {
-		ttime = 100 * (up->pos - tq_savedpos);
-		if (ttime < 0) {
-			ttime = -ttime;
-			tq_status |= TSTATE_BACKWARDS;
-		}
-		ttime += 200000;
-		// sim_debug (DBG_REQ, &tq_dev, "simulated execution time = %d msec\n",ttime / 1000);
+	/* Reschedule for the appropriate delay of this unit */
+	ttime = 100 * (uptr->pos - res->savedpos);
+	if (ttime < 0) {
+		ttime = -ttime;
+		res->status |= TSTATE_BACKWARDS;
 	}
-	else
-		ttime = 200000;
+	ttime += 200000;
+	// sim_debug (DBG_REQ, &tq_dev, "simulated execution time = %d msec\n",ttime / 1000);
     if (ttime > 20000000) ttime = 20000000;
-    tq_savedpos = up->pos;  // status transmits new position
-    if (up) tq_setStatus();
+    res->savedpos = uptr->pos;  // status transmits new position
+    tq_setStatus(res->status, res->savedpos);
     // sim_activate_notbefore (uptr, uptr->iostarttime+tq_xtime);
     sim_activate_after_abs (uptr, ttime);
 }
@@ -1900,8 +1914,8 @@ else
                                tq_pkt[pkt].d[RSP_OPF], tq_pkt[pkt].d[RSP_STS]);
 
 if (up) {
-	tq_status &= ~(TSTATE_BACKWARDS | TSTATE_READ | TSTATE_SEEK | TSTATE_WRITE);
-	tq_setStatus();
+	// the unit of the response stops, only the online light stays on
+	tq_setStatus(TSTATE_ONLINE | (tq_pkt[pkt].d[CMD_UN] == 1 ? TSTATE_DRIVE1 : 0), up->pos);
 }
 
 if (!tq_getdesc (&tq_rq, &desc))                        /* get rsp desc */
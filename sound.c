@@ -0,0 +1,274 @@
+/*
+ * sound.c
+ *
+ * Sound of the turning reels, mixed in the process
+ *
+ * for the Raspberry Pi and other Linux systems
+ *
+ * Copyright 2019  rricharz
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <glib.h>
+
+#include "tape.h"
+#include "sound.h"
+
+#define VOICES		(2 * MAX_DRIVES)	// one for each reel
+#define VOLUME		0.2			// of one reel at full speed
+
+struct voice {
+  double speed;				// requested by the panel
+  double phase;				// position in the motor sound, in samples
+  double volume;			// at the end of the last block
+};
+
+struct sound {
+  FILE *out;
+  int wav;				// 1: WAV file, 0: pipe to aplay
+  long samples;				// written so far
+  float *motor;				// one second of the motor sound, repeated, at most 1.0
+  GThread *thread;
+  GMutex lock;				// protects speed and quit
+  GCond wake;				// wakes up the mixer when a reel starts
+  int quit;
+  struct voice voice[VOICES];
+};
+
+static float *render_motor()
+// one second of a motor turning at the speed of a full reel, repeated seamlessly
+{
+	float *m = g_new(float, SOUND_RATE);
+	double noise = 0.0;
+
+	// all frequencies are whole Hz, so that the end fits to the start
+	for (int i = 0; i < SOUND_RATE; i++) {
+		double t = (double)i / SOUND_RATE;
+		noise += 0.05 * ((double)rand() / RAND_MAX - 0.5 - noise);	// low pass filtered
+		m[i] = 0.5 * sin(2 * M_PI * 100 * t) + 0.25 * sin(2 * M_PI * 200 * t)
+			+ 0.1 * sin(2 * M_PI * 300 * t) + 0.3 * sin(2 * M_PI * FULL_RPS * 4 * t)
+				* sin(2 * M_PI * 50 * t) + 4.0 * noise;
+	}
+	// the filtered noise does not fit, it is faded into the start
+	int fade = SOUND_RATE / 50;
+	for (int i = 0; i < fade; i++) {
+		double w = (double)i / fade;
+		m[i] = w * m[i] + (1.0 - w) * m[SOUND_RATE - fade + i];
+	}
+	// normalized, so that the volumes of the voices add up to the peak of the mix
+	float peak = 0.0;
+	for (int i = 0; i < SOUND_RATE; i++)
+		if (fabsf(m[i]) > peak)
+			peak = fabsf(m[i]);
+	for (int i = 0; i < SOUND_RATE; i++)
+		m[i] /= peak;
+	return m;
+}
+
+static void put16(unsigned char *p, int v)
+{
+	p[0] = v & 255;
+	p[1] = (v >> 8) & 255;
+}
+
+static void put32(unsigned char *p, long v)
+{
+	put16(p, v & 0xffff);
+	put16(p + 2, (v >> 16) & 0xffff);
+}
+
+static void wav_header(struct sound *s)
+// a header for 16 bit mono, with the length of the samples written so far
+{
+	unsigned char h[44];
+	memcpy(h, "RIFF\0\0\0\0WAVEfmt ", 16);
+	put32(h + 4, 36 + 2 * s->samples);
+	put32(h + 16, 16);
+	put16(h + 20, 1);			// PCM
+	put16(h + 22, 1);			// mono
+	put32(h + 24, SOUND_RATE);
+	put32(h + 28, 2 * SOUND_RATE);
+	put16(h + 32, 2);
+	put16(h + 34, 16);
+	memcpy(h + 36, "data", 4);
+	put32(h + 40, 2 * s->samples);
+	fseek(s->out, 0, SEEK_SET);
+	fwrite(h, 1, sizeof(h), s->out);
+	fseek(s->out, 0, SEEK_END);
+}
+
+static void mix(struct sound *s, const double *speed, int16_t *out)
+// mix one block, the volume changes smoothly from the previous block.
+// The mix is scaled down where the voices together could exceed full scale,
+// by the sum of their volumes, which changes as smoothly as the volumes
+{
+	float sum[SOUND_BLOCK];
+	float total[SOUND_BLOCK];
+	memset(sum, 0, sizeof(sum));
+	memset(total, 0, sizeof(total));
+
+	for (int k = 0; k < VOICES; k++) {
+		struct voice *v = &s->voice[k];
+		double step = fabs(speed[k]) / FULL_RPS;	// pitch
+		double volume = VOLUME * (step < 1.0 ? step : 1.0);
+		if ((volume == 0.0) && (v->volume == 0.0))
+			continue;
+		double dv = (volume - v->volume) / SOUND_BLOCK;
+		for (int i = 0; i < SOUND_BLOCK; i++) {
+			int j = (int)v->phase;
+			double f = v->phase - j;
+			double a = s->motor[j], b = s->motor[(j + 1) % SOUND_RATE];
+			v->volume += dv;
+			sum[i] += v->volume * (a + f * (b - a));
+			total[i] += v->volume;
+			v->phase += step;
+			if (v->phase >= SOUND_RATE)
+				v->phase -= SOUND_RATE;
+		}
+		v->volume = volume;
+	}
+	for (int i = 0; i < SOUND_BLOCK; i++) {
+		double g = total[i] > 1.0 ? 1.0 / total[i] : 1.0;
+		int x = (int)(sum[i] * g * 32767);
+		out[i] = x > 32767 ? 32767 : x < -32767 ? -32767 : x;
+	}
+}
+
+static int at_rest(const struct sound *s)
+// all reels stand still and are silent, called by the mixer with the lock held
+{
+	for (int k = 0; k < VOICES; k++)
+		if ((s->voice[k].speed != 0.0) || (s->voice[k].volume != 0.0))
+			return 0;
+	return 1;
+}
+
+static gpointer mix_loop(gpointer data)
+// mixes the reels in real time, one block ahead of the clock
+{
+	struct sound *s = data;
+	double speed[VOICES];
+	int16_t block[SOUND_BLOCK];
+	gint64 start = g_get_monotonic_time();
+	long blocks = 0;
+
+	for (;;) {
+		// nothing is written while all reels are at rest, a reel starting wakes the mixer
+		int waited = 0;
+		g_mutex_lock(&s->lock);
+		while (!s->quit && at_rest(s)) {
+			g_cond_wait(&s->wake, &s->lock);
+			waited = 1;
+		}
+		int quit = s->quit;
+		for (int k = 0; k < VOICES; k++)
+			speed[k] = s->voice[k].speed;
+		g_mutex_unlock(&s->lock);
+		if (quit)
+			break;
+		if (waited) {
+			// the clock goes on, the WAV file keeps the silence
+			long due = (g_get_monotonic_time() - start) * SOUND_RATE / (SOUND_BLOCK * G_USEC_PER_SEC);
+			if (s->wav) {
+				memset(block, 0, sizeof(block));
+				for (; blocks < due; blocks++) {
+					fwrite(block, sizeof(block), 1, s->out);
+					s->samples += SOUND_BLOCK;
+				}
+			}
+			if (due > blocks)
+				blocks = due;
+		}
+
+		mix(s, speed, block);
+		if (fwrite(block, sizeof(block), 1, s->out) != 1) {
+			printf("Cannot play the sound\n");
+			break;
+		}
+		s->samples += SOUND_BLOCK;
+		if (!s->wav)
+			fflush(s->out);
+
+		// aplay blocks when its buffer is full, but the pipe would let the mixer run far ahead
+		blocks++;
+		gint64 ahead = start + (blocks - 1) * SOUND_BLOCK * G_USEC_PER_SEC / SOUND_RATE
+			- g_get_monotonic_time();
+		if (ahead > 0)
+			g_usleep(ahead);
+	}
+	return 0;
+}
+
+struct sound *sound_new(char *sink)
+// sink is "aplay" or the name of a WAV file, return 0 on failure
+{
+	struct sound *s = g_new0(struct sound, 1);
+
+	if (strcmp(sink, "aplay") == 0)
+		s->out = popen(SOUND_APLAY, "w");
+	else {
+		s->out = fopen(sink, "w");
+		s->wav = 1;
+	}
+	if (s->out == 0) {
+		printf("Cannot open %s\n", sink);
+		g_free(s);
+		return 0;
+	}
+	if (s->wav)
+		wav_header(s);
+	s->motor = render_motor();
+	g_mutex_init(&s->lock);
+	g_cond_init(&s->wake);
+	s->thread = g_thread_new("sound", mix_loop, s);
+	return s;
+}
+
+void sound_set(struct sound *s, int drive, double speed1, double speed2)
+// set the speeds of the reels of a drive, in turns per second
+{
+	g_mutex_lock(&s->lock);
+	s->voice[2 * drive].speed = speed1;
+	s->voice[2 * drive + 1].speed = speed2;
+	if ((speed1 != 0.0) || (speed2 != 0.0))
+		g_cond_signal(&s->wake);
+	g_mutex_unlock(&s->lock);
+}
+
+void sound_free(struct sound *s)
+{
+	g_mutex_lock(&s->lock);
+	s->quit = 1;
+	g_cond_signal(&s->wake);
+	g_mutex_unlock(&s->lock);
+	g_thread_join(s->thread);
+	if (s->wav) {
+		wav_header(s);
+		fclose(s->out);
+	}
+	else
+		pclose(s->out);
+	g_free(s->motor);
+	g_free(s);
+}
@@ -0,0 +1,48 @@
+/*
+ * sound.h
+ *
+ * Sound of the turning reels, mixed in the process
+ *
+ * for the Raspberry Pi and other Linux systems
+ *
+ * Copyright 2019  rricharz
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ *
+ */
+
+#ifndef SOUND_H
+#define SOUND_H
+
+// The sound of a reel motor is rendered once at startup, and played back by a mixer
+// thread for every reel, with pitch and volume following the speed of the reel.
+// The mixer writes blocks of a quarter of a timer interval, either to "aplay", which is
+// started once, or to a WAV file for testing without audio hardware. The block mixed
+// ahead and the buffer of aplay delay the sound by less than one timer interval.
+// While all reels are at rest, the mixer waits and writes nothing to aplay.
+
+#define SOUND_RATE		22050		// samples per second
+#define SOUND_BLOCK		(SOUND_RATE * TIME_INTERVAL / 4000)	// samples mixed at once
+#define SOUND_APLAY		"aplay -q -t raw -f S16_LE -c 1 -r 22050 -B 20000"
+
+struct sound;
+
+struct sound *sound_new(char *sink);
+void sound_set(struct sound *s, int drive, double speed1, double speed2);
+void sound_free(struct sound *s);
+
+#endif
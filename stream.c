@@ -0,0 +1,429 @@
+/*
+ * stream.c
+ *
+ * Streams the composed frames over HTTP, as MJPEG for browsers
+ * or as JPEG tiles of the changed parts of the frames
+ *
+ * for the Raspberry Pi and other Linux systems
+ *
+ * Copyright 2019  rricharz
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <gtk/gtk.h>
+
+#include "stream.h"
+
+#define BOUNDARY	"tu77frame"
+#define SEND_TIMEOUT	2		// sec, viewers which take no data for longer are disconnected
+#define RETRY		10		// msec, the parts which did not fit are sent again
+
+#define PART_NONE	0
+#define PART_FULL	1		// the complete frame
+#define PART_TILE	2		// the changed rectangle
+
+struct client {
+  int fd;
+  int tiles;				// changed rectangles instead of complete frames
+  int need_full;			// the next part is a complete frame
+  int part;				// part sent by the encoder
+  char *out;				// rest of a part not taken by the socket yet, or 0
+  size_t outsize, sent;
+  gint64 stalled;			// monotonic time when the socket was found full, or 0
+  int dead;
+  struct client *next;
+};
+
+struct stream {
+  int fd;				// listening socket
+  GThread *accept_thread, *encode_thread;
+  GMutex lock;				// protects all fields below
+  GCond wake;				// wakes up the encoder
+  cairo_surface_t *image;		// copy of the newest frame, 0 while nobody watches
+  GSourceFunc refresh;			// asks the main thread for a frame
+  cairo_rectangle_int_t dirty;		// changed since the last encoding, width 0 if none
+  struct client *clients;		// new clients are only added at the head
+  int quit;
+};
+
+static const char page[] =
+	"<html><head><title>tu77</title></head>"
+	"<body style=\"background:black;margin:0\">"
+	"<img src=\"/mjpeg\" style=\"width:100%\"></body></html>";
+
+static int send_all(struct client *c, const void *data, size_t n)
+// send all data to a client, mark it dead if that is not possible
+{
+	const char *p = data;
+	while (!c->dead && (n > 0)) {
+		ssize_t k = send(c->fd, p, n, MSG_NOSIGNAL);
+		if (k <= 0)
+			c->dead = 1;
+		else {
+			p += k;
+			n -= k;
+		}
+	}
+	return !c->dead;
+}
+
+static void flush_client(struct client *c)
+// send what the socket of a streaming client takes without blocking
+{
+	while (!c->dead && (c->out != 0)) {
+		ssize_t k = send(c->fd, c->out + c->sent, c->outsize - c->sent, MSG_NOSIGNAL);
+		if (k > 0) {
+			c->stalled = 0;
+			c->sent += k;
+			if (c->sent == c->outsize) {
+				g_free(c->out);
+				c->out = 0;
+			}
+		}
+		else if ((k < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+			gint64 now = g_get_monotonic_time();
+			if (c->stalled == 0)
+				c->stalled = now;
+			else if (now - c->stalled > SEND_TIMEOUT * G_USEC_PER_SEC)
+				c->dead = 1;
+			return;
+		}
+		else if ((k < 0) && (errno == EINTR))
+			continue;
+		else
+			c->dead = 1;
+	}
+}
+
+static void send_part(struct client *c, const gchar *jpeg, gsize size,
+	const cairo_rectangle_int_t *r, int width, int height)
+// queue a part for a client which has sent all previous parts
+{
+	char h[256];
+	int n = snprintf(h, sizeof(h),
+		"--" BOUNDARY "\r\nContent-Type: image/jpeg\r\nContent-Length: %d\r\n"
+		"X-Rect: %d %d %d %d\r\nX-Size: %d %d\r\n\r\n",
+		(int)size, r->x, r->y, r->width, r->height, width, height);
+	c->outsize = n + size + 2;
+	c->sent = 0;
+	c->out = g_malloc(c->outsize);
+	memcpy(c->out, h, n);
+	memcpy(c->out + n, jpeg, size);
+	memcpy(c->out + n + size, "\r\n", 2);
+	flush_client(c);
+}
+
+static void remove_dead(struct stream *s)
+// called with the lock held
+{
+	for (struct client **p = &s->clients; *p != 0;) {
+		struct client *c = *p;
+		if (c->dead) {
+			close(c->fd);
+			*p = c->next;
+			g_free(c->out);
+			g_free(c);
+		}
+		else
+			p = &c->next;
+	}
+}
+
+static int encode(GdkPixbuf *pb, gchar **jpeg, gsize *size)
+{
+	GError *error = 0;
+	if (!gdk_pixbuf_save_to_buffer(pb, jpeg, size, "jpeg", &error, "quality", STREAM_QUALITY, NULL)) {
+		printf("Cannot encode frame: %s\n", error->message);
+		g_error_free(error);
+		return 0;
+	}
+	return 1;
+}
+
+static gpointer encode_loop(gpointer data)
+// encode the changes of the frames once for all clients, the sockets never block,
+// a client which has not taken the previous part yet misses the frame
+{
+	struct stream *s = data;
+
+	g_mutex_lock(&s->lock);
+	for (;;) {
+		int work = 0, behind = 0;
+		for (struct client *c = s->clients; c != 0; c = c->next) {
+			work |= (c->out == 0) && ((s->dirty.width > 0) || c->need_full);
+			behind |= c->out != 0;
+		}
+		if (s->quit)
+			break;
+		if ((s->image == 0) || !work) {
+			if (!behind) {
+				g_cond_wait(&s->wake, &s->lock);
+				continue;
+			}
+			g_cond_wait_until(&s->wake, &s->lock, g_get_monotonic_time() + RETRY * 1000);
+			struct client *clients = s->clients;
+			g_mutex_unlock(&s->lock);
+			for (struct client *c = clients; c != 0; c = c->next)
+				flush_client(c);
+			g_mutex_lock(&s->lock);
+			remove_dead(s);
+			continue;
+		}
+
+		int full = 0, tile = 0;
+		struct client *clients = s->clients;
+		for (struct client *c = clients; c != 0; c = c->next) {
+			if (c->out != 0) {
+				// the tiles build on each other, after a missed one a full frame follows
+				c->part = PART_NONE;
+				if (c->tiles && (s->dirty.width > 0))
+					c->need_full = 1;
+				continue;
+			}
+			if (c->need_full)
+				c->part = PART_FULL;
+			else if (s->dirty.width == 0)
+				c->part = PART_NONE;
+			else
+				c->part = c->tiles ? PART_TILE : PART_FULL;
+			c->need_full = 0;
+			full |= c->part == PART_FULL;
+			tile |= c->part == PART_TILE;
+		}
+
+		// the pixels are copied while the render thread cannot change them
+		int width = cairo_image_surface_get_width(s->image);
+		int height = cairo_image_surface_get_height(s->image);
+		cairo_rectangle_int_t all = { 0, 0, width, height };
+		cairo_rectangle_int_t dirty = s->dirty;
+		GdkPixbuf *fpb = full ? gdk_pixbuf_get_from_surface(s->image, 0, 0, width, height) : 0;
+		GdkPixbuf *tpb = tile ? gdk_pixbuf_get_from_surface(s->image,
+			dirty.x, dirty.y, dirty.width, dirty.height) : 0;
+		s->dirty.width = 0;
+		g_mutex_unlock(&s->lock);
+
+		gchar *fjpeg = 0, *tjpeg = 0;
+		gsize fsize = 0, tsize = 0;
+		if (fpb != 0) {
+			encode(fpb, &fjpeg, &fsize);
+			g_object_unref(fpb);
+		}
+		if (tpb != 0) {
+			encode(tpb, &tjpeg, &tsize);
+			g_object_unref(tpb);
+		}
+
+		// clients added in the meantime are in front of clients, and wait for a full frame
+		for (struct client *c = clients; c != 0; c = c->next) {
+			if (c->out != 0)
+				flush_client(c);
+			else if ((c->part == PART_FULL) && (fjpeg != 0))
+				send_part(c, fjpeg, fsize, &all, width, height);
+			else if ((c->part == PART_TILE) && (tjpeg != 0))
+				send_part(c, tjpeg, tsize, &dirty, width, height);
+		}
+		g_free(fjpeg);
+		g_free(tjpeg);
+
+		g_mutex_lock(&s->lock);
+		remove_dead(s);
+	}
+	g_mutex_unlock(&s->lock);
+	return 0;
+}
+
+static gpointer accept_loop(gpointer data)
+// answer the requests, the streams are sent by the encoder
+{
+	struct stream *s = data;
+	char request[1024];
+
+	for (;;) {
+		int fd = accept(s->fd, 0, 0);
+		if (fd < 0)
+			break;
+		struct timeval tv = { SEND_TIMEOUT, 0 };
+		setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+		setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+		ssize_t n = recv(fd, request, sizeof(request) - 1, 0);
+		request[n > 0 ? n : 0] = 0;
+
+		struct client *c = g_new0(struct client, 1);
+		c->fd = fd;
+		c->need_full = 1;
+		if (strncmp(request, "GET / ", 6) == 0) {
+			char h[128];
+			int k = snprintf(h, sizeof(h), "HTTP/1.0 200 OK\r\nContent-Type: text/html\r\n"
+				"Content-Length: %d\r\n\r\n", (int)strlen(page));
+			if (send_all(c, h, k))
+				send_all(c, page, strlen(page));
+			c->dead = 1;
+		}
+		else if ((strncmp(request, "GET /mjpeg ", 11) == 0) || (strncmp(request, "GET /tiles ", 11) == 0)) {
+			const char h[] = "HTTP/1.0 200 OK\r\nCache-Control: no-cache\r\n"
+				"Content-Type: multipart/x-mixed-replace; boundary=" BOUNDARY "\r\n\r\n";
+			c->tiles = request[5] == 't';
+			send_all(c, h, strlen(h));
+		}
+		else {
+			const char h[] = "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+			send_all(c, h, strlen(h));
+			c->dead = 1;
+		}
+		if (c->dead) {
+			close(fd);
+			g_free(c);
+			continue;
+		}
+		// the encoder sends the parts without waiting for a slow viewer
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+		g_mutex_lock(&s->lock);
+		c->next = s->clients;
+		s->clients = c;
+		if (s->image == 0)
+			g_idle_add(s->refresh, 0);
+		g_cond_signal(&s->wake);
+		g_mutex_unlock(&s->lock);
+	}
+	return 0;
+}
+
+struct stream *stream_new(char *address, GSourceFunc refresh)
+// listen on [address:]port, on localhost if no address is given, return 0 on failure
+// refresh is called in the main thread when a viewer needs a frame to start with
+{
+	struct sockaddr_in sa;
+	char host[64] = "127.0.0.1";
+	char *colon = strrchr(address, ':');
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sin_family = AF_INET;
+	if (colon != 0) {
+		snprintf(host, sizeof(host), "%.*s", (int)(colon - address), address);
+		address = colon + 1;
+	}
+	sa.sin_port = htons(atoi(address));
+	if (inet_pton(AF_INET, host, &sa.sin_addr) != 1) {
+		printf("Cannot stream to %s\n", host);
+		return 0;
+	}
+	int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	int on = 1;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+	if ((fd < 0) || (bind(fd, (struct sockaddr *)&sa, sizeof(sa)) != 0) || (listen(fd, 8) != 0)) {
+		printf("Cannot listen on %s:%d\n", host, ntohs(sa.sin_port));
+		if (fd >= 0)
+			close(fd);
+		return 0;
+	}
+	printf("Streaming on http://%s:%d/\n", host, ntohs(sa.sin_port));
+
+	struct stream *s = g_new0(struct stream, 1);
+	s->fd = fd;
+	s->refresh = refresh;
+	g_mutex_init(&s->lock);
+	g_cond_init(&s->wake);
+	s->accept_thread = g_thread_new("http", accept_loop, s);
+	s->encode_thread = g_thread_new("jpeg", encode_loop, s);
+	return s;
+}
+
+void stream_frame(struct stream *s, cairo_surface_t *frame, const cairo_rectangle_int_t *damage)
+// copy the changed part of a frame, called by the render thread after each frame
+{
+	int width = cairo_image_surface_get_width(frame);
+	int height = cairo_image_surface_get_height(frame);
+	cairo_rectangle_int_t r = *damage;
+
+	g_mutex_lock(&s->lock);
+	if (s->clients == 0) {
+		// nobody watches, the next viewer starts with a complete copy
+		if (s->image != 0)
+			cairo_surface_destroy(s->image);
+		s->image = 0;
+		s->dirty.width = 0;
+		g_mutex_unlock(&s->lock);
+		return;
+	}
+	if ((s->image == 0) || (cairo_image_surface_get_width(s->image) != width)
+			|| (cairo_image_surface_get_height(s->image) != height)) {
+		if (s->image != 0)
+			cairo_surface_destroy(s->image);
+		s->image = cairo_image_surface_create(CAIRO_FORMAT_RGB24, width, height);
+		r.x = r.y = 0;
+		r.width = width;
+		r.height = height;
+		s->dirty.width = 0;
+	}
+	if (r.width > 0) {
+		cairo_t *cr = cairo_create(s->image);
+		cairo_rectangle(cr, r.x, r.y, r.width, r.height);
+		cairo_clip(cr);
+		cairo_set_source_surface(cr, frame, 0, 0);
+		cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+		cairo_paint(cr);
+		cairo_destroy(cr);
+		cairo_surface_flush(s->image);
+		if (s->dirty.width == 0)
+			s->dirty = r;
+		else {
+			int x1 = MAX(s->dirty.x + s->dirty.width, r.x + r.width);
+			int y1 = MAX(s->dirty.y + s->dirty.height, r.y + r.height);
+			s->dirty.x = MIN(s->dirty.x, r.x);
+			s->dirty.y = MIN(s->dirty.y, r.y);
+			s->dirty.width = x1 - s->dirty.x;
+			s->dirty.height = y1 - s->dirty.y;
+		}
+		g_cond_signal(&s->wake);
+	}
+	g_mutex_unlock(&s->lock);
+}
+
+void stream_free(struct stream *s)
+{
+	g_mutex_lock(&s->lock);
+	s->quit = 1;
+	g_cond_signal(&s->wake);
+	g_mutex_unlock(&s->lock);
+	shutdown(s->fd, SHUT_RDWR);
+	g_thread_join(s->accept_thread);
+	g_thread_join(s->encode_thread);
+	close(s->fd);
+	while (s->clients != 0) {
+		struct client *c = s->clients;
+		s->clients = c->next;
+		close(c->fd);
+		g_free(c->out);
+		g_free(c);
+	}
+	if (s->image != 0)
+		cairo_surface_destroy(s->image);
+	g_free(s);
+}
@@ -0,0 +1,56 @@
+/*
+ * stream.h
+ *
+ * Streams the composed frames over HTTP, as MJPEG for browsers
+ * or as JPEG tiles of the changed parts of the frames
+ *
+ * for the Raspberry Pi and other Linux systems
+ *
+ * Copyright 2019  rricharz
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ *
+ */
+
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <glib.h>
+#include <cairo.h>
+
+// The server answers
+//
+//   /        a page showing the MJPEG stream
+//   /mjpeg   multipart/x-mixed-replace, a complete JPEG for every frame
+//   /tiles   multipart/x-mixed-replace, the first part is the complete frame, the
+//            following parts only the rectangle which has changed since the previous part
+//
+// Each part has the headers "X-Rect: x y width height" and "X-Size: width height",
+// the position of the JPEG in the frame and the size of the frame in pixels.
+// The frames are encoded once by a worker thread for all viewers, and only when
+// something has changed. A viewer which has not taken the previous part yet misses
+// the frame, instead of holding up the others.
+
+#define STREAM_QUALITY		"80"		// JPEG quality
+
+struct stream;
+
+struct stream *stream_new(char *address, GSourceFunc refresh);
+void stream_frame(struct stream *s, cairo_surface_t *frame, const cairo_rectangle_int_t *damage);
+void stream_free(struct stream *s);
+
+#endif
@@ -0,0 +1,161 @@
+/*
+ * tape.h
+ *
+ * Common definitions of the magtape front panel engine,
+ * shared by the TU77 and the TE16 front panels
+ *
+ * for the Raspberry Pi and other Linux systems
+ *
+ * Copyright 2019  rricharz
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ *
+ */
+
+#ifndef TAPE_H
+#define TAPE_H
+
+#define VERSION			"0.4"
+
+#define TSTATE_ONLINE		1
+#define TSTATE_DRIVE1		2
+#define TSTATE_BACKWARDS	4
+#define TSTATE_SEEK		8
+#define TSTATE_READ		16
+#define TSTATE_WRITE		32
+
+// The tape status is checked every TIME_INTERVAL milliseconds
+// If the status changes, the display is updated immediately
+
+#define TIME_INTERVAL		40		// timer interval in msec
+
+#define NUMANGLES		10		// number of angles simulated
+#define CAPACITY		2000000		// 2 Mbyte for now (need better value)
+#define MIN_TRADIUS		100.0		// tape radius in dots
+#define MAX_TRADIUS		190.0		// tape radius in dots
+#define FULL_RPS		4.44		// in turns per second
+#define ACCELERATION		1.0		// adjust accelation
+
+#define HUB_OFFSET		104		// position of the hub on the removable reel
+#define LABELW			120
+#define LABELH			20
+#define LABELP			135
+
+// mkpyramid stores the pictures halved and quartered as pyramid/2/... and pyramid/4/...
+// The panel decodes the smallest level which is still at least as large as the display
+
+#define PYRAMID_DIR		"pyramid"
+#define PYRAMID_LEVELS		4		// smallest level, 1 / 4 of the full size
+
+#define NUM_BUTTONS		4
+#define BUTTON_ONLINE		1
+#define MAX_WHEELS		4
+#define MAX_DRIVES		8		// maximal number of drives in one window
+
+// The SimH driver reports the position only when a tape motion command completes.
+// Tape motion between these sparse updates is extrapolated from a filtered velocity.
+// The filter restarts from the driver timing when no position was observed recently
+
+#define EST_WINDOW		1000		// msec, an older observation is forgotten
+#define EST_ALPHA		0.5		// alpha-beta-gamma filter gains
+#define EST_BETA		0.2
+#define EST_GAMMA		0.02
+#define MAX_VELOCITY		(CAPACITY / 20000.0)	// positions per msec, the driver moves for 20 sec at most
+
+struct estimator {
+  long last_t;				// time of the last observation in msec
+  int valid;				// 0 before the first observation
+  double x, v, a;			// filtered position, velocity and acceleration
+};
+
+// A drive model describes everything which differs between the emulated drives.
+// All positions are in dots of the picture of the open drive.
+
+#define COLUMN_ARC		0		// only the tape loop is visible in the columns
+#define COLUMN_LOOP		1		// tape loop and tape leading to the top of the columns
+
+struct column {
+  int x, y, r;				// center and radius of the tape loop at rest
+  int topl, topr;			// top of the left and right tape in the column
+  int dir;				// 1: loop grows downwards, -1: loop grows upwards
+  int max_delta;			// maximal delta of the tape loop
+};
+
+struct model {
+  char *name;				// name of the program and of the window
+  char *image;				// picture of the open drive
+  char *capstan, *capstanb[2];		// capstan at rest and in motion
+  int capstanx, capstany;
+  int reel1x, reel1y;			// fixed reel
+  int reel2x, reel2y;			// removable reel
+  int columnStyle;
+  struct column vc1, vc2;		// vacuum columns
+  double scale_vc;			// scaling for vacuum column
+  char *wheel, *wheelb[2];		// tape guide wheels at rest and in motion
+  int numwheels;
+  int wheelx[MAX_WHEELS], wheely[MAX_WHEELS];
+  int numbuttons;			// 0 if the drive has no active buttons
+  int buttonx, buttony, buttonsize, buttonoffset;
+  int led_power_x, led_online_x, led_bot_x, led_y, led_radius;
+};
+
+extern const struct model tu77_model;
+extern const struct model te16_model;
+extern const struct model *models[];
+
+// The state of one emulated drive
+
+struct drive {
+  const struct model *model;
+  int unit;				// tape unit 0 or 1
+  int buttonState[NUM_BUTTONS];
+  char *label;
+  int remote_status, last_remote_status;
+  double requested_speed1, actual_speed1, requested_speed2, actual_speed2;
+  double angle1, angle2;
+  double radius1, radius2;
+  double delta_vc1, delta_vc2;
+  int position, target;
+  struct estimator est;
+  long tms;				// time of the last update in msec
+  double delta_t;			// time since the previous update in msec
+};
+
+// A simulated clock only moves by the steps given, and the jitter of the vacuum
+// columns can be seeded. Only tapexport, which passes the times to do_logic itself,
+// produces the same frames in every run
+
+long mSeconds();
+void clock_simulate(long t);
+void clock_step(long msec);
+void jitter_seed(unsigned seed);
+
+// The status file contains one record, the character 32 + status followed by the
+// position. Newer writers add the time of CLOCK_MONOTONIC in usec and a sequence
+// number, counting the records written: "%c%d %lld %lu\n"
+
+int getStatus(int *position);
+int getStatusStamp(int *position, long long *stamp, unsigned long *seq);
+
+void drive_init(struct drive *d, const struct model *m);
+void do_logic(struct drive *d, int status, int position, long t);
+
+const struct model *find_model(char *name);
+
+int panel_main(const struct model *m, int argc, char *argv[]);
+
+#endif
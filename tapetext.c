@@ -0,0 +1,170 @@
+/*
+ * tapetext.c
+ *
+ * Text display of the magtape drives in a terminal, for machines without a display
+ *
+ * usage: tapetext model[:unit] [-unit1] [-label text] ...
+ *
+ * Each drive is shown on one line, with its leds, the turning reels,
+ * the direction, the loops in the vacuum columns and the tape position.
+ * The key q quits, the keys 1 ... 9 toggle the ONLINE button of a drive.
+ *
+ * for the Raspberry Pi and other Linux systems
+ *
+ * Copyright 2019  rricharz
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <ncurses.h>
+
+#include "tape.h"
+
+#define MAX_TEXT_DRIVES		64		// the drives are not composed into one picture here
+#define GAUGE			9		// width of the vacuum column and position gauges
+
+static struct drive drive[MAX_TEXT_DRIVES];
+static char name[MAX_TEXT_DRIVES][32];
+static int numdrives;
+
+static char reel(double angle, double speed)
+// a character which turns with the reel
+{
+	static const char c[] = "|/-\\";
+	if (speed == 0.0)
+		return 'o';
+	return c[(int)(angle / 45.0) & 3];
+}
+
+static void gauge(char *s, double value, double max)
+// a gauge of GAUGE characters, showing value between -max and max
+{
+	int k = (int)((value / max + 1.0) * (GAUGE - 1) / 2.0 + 0.5);
+	if (k < 0) k = 0;
+	if (k > GAUGE - 1) k = GAUGE - 1;
+	memset(s, '-', GAUGE);
+	s[k] = 'o';
+	s[GAUGE] = 0;
+}
+
+static void draw_drive(int row, struct drive *d, char *dname)
+{
+	char vc1[GAUGE + 1], vc2[GAUGE + 1], pos[GAUGE + 1];
+	int st = d->remote_status;
+	const char *motion = (st & TSTATE_WRITE) ? "WRITE" : (st & TSTATE_READ) ? "READ" :
+		(st & TSTATE_SEEK) ? "SEEK" : "";
+	const char *dir = (st & (TSTATE_WRITE | TSTATE_READ | TSTATE_SEEK)) ?
+		((st & TSTATE_BACKWARDS) ? "<<" : ">>") : "  ";
+
+	gauge(vc1, d->delta_vc1, d->model->vc1.max_delta);
+	gauge(vc2, d->delta_vc2, d->model->vc2.max_delta);
+	memset(pos, '.', GAUGE);
+	memset(pos, '#', (int)((long)d->position * GAUGE / CAPACITY));
+	pos[GAUGE] = 0;
+
+	mvprintw(row, 0, "%-8s %-2s %-3s (%c)(%c) %-5s%s %s %s %7d [%s] %s",
+		dname,
+		d->buttonState[BUTTON_ONLINE] ? "ON" : "",
+		d->position == 0 ? "BOT" : "",
+		reel(d->angle1, d->actual_speed1), reel(d->angle2, d->actual_speed2),
+		motion, dir, vc1, vc2, d->position, pos, d->label);
+	clrtoeol();
+}
+
+int main(int argc, char *argv[])
+{
+	struct drive *d = 0;
+	int moving[MAX_TEXT_DRIVES];
+
+	for (int i = 1; i < argc; i++) {
+		if ((strcmp(argv[i], "-unit1") == 0) && d)
+			d->unit = 1;
+		else if ((strcmp(argv[i], "-label") == 0) && d && (i + 1 < argc))
+			d->label = argv[++i];
+		else if ((argv[i][0] != '-') && (numdrives < MAX_TEXT_DRIVES)) {
+			char *colon = strchr(argv[i], ':');
+			snprintf(name[numdrives], sizeof(name[0]), "%.*s",
+				colon ? (int)(colon - argv[i]) : (int)strlen(argv[i]), argv[i]);
+			const struct model *m = find_model(name[numdrives]);
+			if (m == 0) {
+				printf("tapetext: unknown model %s\n", argv[i]);
+				exit(1);
+			}
+			d = &drive[numdrives];
+			drive_init(d, m);
+			d->unit = colon ? atoi(colon + 1) != 0 : 0;
+			numdrives++;
+		}
+		else {
+			printf("tapetext: unknown argument %s\n", argv[i]);
+			exit(1);
+		}
+	}
+	if (numdrives == 0) {
+		printf("usage: tapetext model[:unit] [-unit1] [-label text] ...\n");
+		exit(1);
+	}
+	for (int i = 0; i < numdrives; i++) // -unit1 may have been given after the model
+		snprintf(name[i], sizeof(name[0]), "%s:%d", drive[i].model->name, drive[i].unit);
+
+	initscr();
+	cbreak();
+	noecho();
+	curs_set(0);
+	timeout(TIME_INTERVAL);
+
+	mvprintw(0, 0, "tapetext version %s, q to quit, 1 ... 9 to toggle ON(LINE)", VERSION);
+	for (int i = 0; i < numdrives; i++) {
+		draw_drive(i + 2, &drive[i], name[i]);
+		moving[i] = 0;
+	}
+
+	for (;;) {
+		int key = getch();
+		if (key == 'q')
+			break;
+		if ((key >= '1') && (key <= '9') && (key - '1' < numdrives))
+			drive[key - '1'].buttonState[BUTTON_ONLINE] ^= 1;
+
+		// the status file is read once for all drives
+		int position = -1;
+		int status = getStatus(&position);
+		long t = mSeconds();
+
+		// only the lines of drives which move or have changed are redrawn
+		for (int i = 0; i < numdrives; i++) {
+			d = &drive[i];
+			int last = d->remote_status;
+			int lastpos = d->position;
+			do_logic(d, status, position, t);
+			int now = (d->actual_speed1 != 0) || (d->actual_speed2 != 0) ||
+				(fabs(d->delta_vc1) >= 0.5) || (fabs(d->delta_vc2) >= 0.5);
+			if (now || moving[i] || (last != d->remote_status) || (lastpos != d->position) ||
+					(key == '1' + i))
+				draw_drive(i + 2, d, name[i]);
+			moving[i] = now;
+		}
+		refresh();
+	}
+	endwin();
+	return 0;
+}
@@ -0,0 +1,373 @@
+/*
+ * tapexport.c
+ *
+ * Renders the front panels offscreen from a recorded status trace,
+ * as a Y4M video or as a sequence of PNG pictures
+ *
+ * usage: tapexport [-fps n] [-width w] [-smooth] [-threads n] -o out.y4m|directory
+ *                  trace model[:unit] [-unit1] [-label text] ...
+ *
+ * At most 25 frames per second are rendered, the rate at which the drives are simulated.
+ *
+ * Each line of the trace is "msec status position", the time in msec,
+ * the status bits as written by the SimH driver (without the offset of 32)
+ * and the tape position. Lines starting with # are ignored.
+ *
+ * for the Raspberry Pi and other Linux systems
+ *
+ * Copyright 2019  rricharz
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#include "render.h"
+
+#define MAX_TAIL	10000		// msec simulated after the last record until the reels stop
+
+struct record {
+  long t;
+  int status;
+  int position;
+};
+
+// The drives are simulated sequentially, in steps of TIME_INTERVAL like the panel.
+// Each frame is a copy of the drives, composed and encoded by a pool of threads.
+// The Y4M frames are written in order by the main thread.
+
+struct job {
+  int index;
+  struct view view[MAX_DRIVES];
+  unsigned char *yuv;			// encoded Y4M frame, 0 for PNG
+  int failed;				// the PNG could not be written
+  int done;
+};
+
+static struct {
+  struct view view[MAX_DRIVES];
+  int numviews;
+  struct cache *cache;
+  int width, height;			// size of the frames in pixels
+  char *out;
+  int y4m;				// 1: Y4M video, 0: PNG sequence
+  FILE *video;
+  GMutex lock;				// protects done of all jobs
+  GCond done;
+  struct job **inflight;		// jobs not yet written, by frame index modulo window
+  int window;
+  int failed;				// a frame could not be written, used by the main thread
+} glob;
+
+static struct record *read_trace(char *name, int *n)
+// read all records of a trace, in the order of their time
+{
+	char line[256];
+	int max = 0;
+	struct record *r = 0;
+	FILE *f = fopen(name, "r");
+
+	if (f == 0) {
+		printf("Cannot open %s\n", name);
+		exit(1);
+	}
+	*n = 0;
+	while (fgets(line, sizeof(line), f) != 0) {
+		struct record rec;
+		if ((line[0] == '#') || (line[0] == '\n'))
+			continue;
+		if (sscanf(line, "%ld %d %d", &rec.t, &rec.status, &rec.position) != 3) {
+			printf("%s: cannot parse %s", name, line);
+			exit(1);
+		}
+		if ((*n > 0) && (rec.t < r[*n - 1].t)) {
+			printf("%s: time goes backwards at %ld\n", name, rec.t);
+			exit(1);
+		}
+		if (*n >= max) {
+			max = 2 * max + 256;
+			r = g_renew(struct record, r, max);
+		}
+		r[(*n)++] = rec;
+	}
+	fclose(f);
+	if (*n == 0) {
+		printf("%s: no records\n", name);
+		exit(1);
+	}
+	return r;
+}
+
+static unsigned char *to_i420(const struct frame *f)
+// convert a RGB24 frame of even size to planar YUV 4:2:0, full range BT.601
+{
+	int w = f->width, h = f->height;
+	unsigned char *yuv = g_malloc(w * h * 3 / 2);
+	unsigned char *py = yuv, *pu = yuv + w * h, *pv = pu + w * h / 4;
+
+	for (int y = 0; y < h; y += 2) {
+		const uint32_t *s0 = f->data + y * f->stride;
+		const uint32_t *s1 = s0 + f->stride;
+		for (int x = 0; x < w; x += 2) {
+			uint32_t p[4] = { s0[x], s0[x + 1], s1[x], s1[x + 1] };
+			int rs = 2, gs = 2, bs = 2;
+			for (int i = 0; i < 4; i++) {
+				int r = (p[i] >> 16) & 255, g = (p[i] >> 8) & 255, b = p[i] & 255;
+				py[(y + (i >> 1)) * w + x + (i & 1)] = (77 * r + 150 * g + 29 * b + 128) >> 8;
+				rs += r;
+				gs += g;
+				bs += b;
+			}
+			rs >>= 2;
+			gs >>= 2;
+			bs >>= 2;
+			int u = (-43 * rs - 85 * gs + 128 * bs + 32896) >> 8;
+			int v = (128 * rs - 107 * gs - 21 * bs + 32896) >> 8;
+			pu[(y / 2) * (w / 2) + x / 2] = u > 255 ? 255 : u;
+			pv[(y / 2) * (w / 2) + x / 2] = v > 255 ? 255 : v;
+		}
+	}
+	return yuv;
+}
+
+static void render_job(gpointer data, gpointer user_data)
+// compose and encode one frame, called by the threads of the pool
+{
+	struct job *job = data;
+	struct frame f;
+	cairo_surface_t *s = cairo_image_surface_create(CAIRO_FORMAT_RGB24, glob.width, glob.height);
+
+	frame_init(&f, s);
+	for (int i = 0; i < glob.numviews; i++) {
+		struct view *v = &job->view[i];
+		cairo_rectangle_int_t clip;
+		clip.x = px(glob.cache, v->x);
+		clip.y = 0;
+		clip.width = px(glob.cache, v->x + v->width);
+		clip.height = px(glob.cache, v->height);
+		if (clip.width > glob.width) clip.width = glob.width;
+		if (clip.height > glob.height) clip.height = glob.height;
+		clip.width -= clip.x;
+		render_view(&f, glob.cache, 0, v, &glob.cache->view[i], &clip);
+	}
+	cairo_surface_mark_dirty(s);
+
+	if (glob.y4m)
+		job->yuv = to_i420(&f);
+	else {
+		char name[1024];
+		snprintf(name, sizeof(name), "%s/frame%06d.png", glob.out, job->index);
+		if (cairo_surface_write_to_png(s, name) != CAIRO_STATUS_SUCCESS) {
+			printf("Cannot write %s\n", name);
+			job->failed = 1;
+		}
+	}
+	cairo_surface_destroy(s);
+
+	g_mutex_lock(&glob.lock);
+	job->done = 1;
+	g_cond_broadcast(&glob.done);
+	g_mutex_unlock(&glob.lock);
+}
+
+static void finish_job(int index)
+// wait until a frame is encoded and write it, unless a frame has failed already
+{
+	struct job *job = glob.inflight[index % glob.window];
+	size_t size = glob.width * glob.height * 3 / 2;
+
+	g_mutex_lock(&glob.lock);
+	while (!job->done)
+		g_cond_wait(&glob.done, &glob.lock);
+	g_mutex_unlock(&glob.lock);
+	if (job->failed)
+		glob.failed = 1;
+	if (glob.y4m) {
+		if (!glob.failed && ((fputs("FRAME\n", glob.video) == EOF) ||
+				(fwrite(job->yuv, 1, size, glob.video) != size))) {
+			printf("Cannot write %s\n", glob.out);
+			glob.failed = 1;
+		}
+		g_free(job->yuv);
+	}
+	g_free(job);
+	glob.inflight[index % glob.window] = 0;
+}
+
+static int step(long t, int status, int position)
+// simulate all drives for one time interval, return 0 if all drives are idle
+{
+	int idle = 1;
+	for (int i = 0; i < glob.numviews; i++) {
+		struct view *v = &glob.view[i];
+		struct drive *d = &v->drive;
+		do_logic(d, status, position, t);
+		if (d->requested_speed1 != 0.0)
+			v->capstan_index = (v->capstan_index + 1) & 1;
+		if ((d->actual_speed1 != 0) || (d->actual_speed2 != 0) ||
+				(d->requested_speed1 != 0) || (d->requested_speed2 != 0))
+			idle = 0;
+	}
+	return !idle;
+}
+
+int main(int argc, char *argv[])
+{
+	double fps = 25.0;
+	int width = 0;
+	int threads = g_get_num_processors();
+	char *trace = 0;
+	struct view *v = 0;
+	int dots_width, dots_height;
+
+	blit_init();
+	ropt.lowmem = 0;
+	ropt.smooth = 0;
+	glob.numviews = 0;
+
+	for (int i = 1; i < argc; i++) {
+		if ((strcmp(argv[i], "-fps") == 0) && (i + 1 < argc))
+			fps = atof(argv[++i]);
+		else if ((strcmp(argv[i], "-width") == 0) && (i + 1 < argc))
+			width = atoi(argv[++i]);
+		else if ((strcmp(argv[i], "-threads") == 0) && (i + 1 < argc))
+			threads = atoi(argv[++i]);
+		else if ((strcmp(argv[i], "-o") == 0) && (i + 1 < argc))
+			glob.out = argv[++i];
+		else if (strcmp(argv[i], "-smooth") == 0)
+			ropt.smooth = 1;
+		else if ((strcmp(argv[i], "-unit1") == 0) && v)
+			v->drive.unit = 1;
+		else if ((strcmp(argv[i], "-label") == 0) && v && (i + 1 < argc))
+			v->drive.label = argv[++i];
+		else if ((argv[i][0] != '-') && (trace == 0))
+			trace = argv[i];
+		else if ((argv[i][0] != '-') && (glob.numviews < MAX_DRIVES) &&
+				view_init(&glob.view[glob.numviews], argv[i]))
+			v = &glob.view[glob.numviews++];
+		else {
+			printf("tapexport: unknown argument %s\n", argv[i]);
+			exit(1);
+		}
+	}
+	if ((trace == 0) || (glob.out == 0) || (glob.numviews == 0) || (fps <= 0) || (threads < 1)) {
+		printf("usage: tapexport [-fps n] [-width w] [-smooth] [-threads n] -o out.y4m|directory\n"
+			"                 trace model[:unit] [-unit1] [-label text] ...\n");
+		exit(1);
+	}
+	// the drives move in steps of TIME_INTERVAL, more frames would only repeat them
+	if (fps > 1000.0 / TIME_INTERVAL) {
+		fps = 1000.0 / TIME_INTERVAL;
+		printf("tapexport: the drives are simulated in steps of %d msec, using -fps %.0f\n",
+			TIME_INTERVAL, fps);
+	}
+
+	int n;
+	struct record *r = read_trace(trace, &n);
+
+	// the frames have an even size, as required by YUV 4:2:0
+	layout_views(glob.view, glob.numviews, &dots_width, &dots_height);
+	if (width <= 0)
+		width = dots_width / 2;
+	double scale = (double)width / dots_width;
+	glob.width = (width + 1) & ~1;
+	glob.height = ((int)ceil(dots_height * scale) + 1) & ~1;
+	glob.cache = new_cache(scale, 1, glob.view, glob.numviews);
+
+	size_t len = strlen(glob.out);
+	glob.y4m = (len > 4) && (strcmp(glob.out + len - 4, ".y4m") == 0);
+	if (glob.y4m) {
+		glob.video = fopen(glob.out, "w");
+		if (glob.video == 0) {
+			printf("Cannot open %s\n", glob.out);
+			exit(1);
+		}
+		fprintf(glob.video, "YUV4MPEG2 W%d H%d F%d:1000 Ip A1:1 C420jpeg\n",
+			glob.width, glob.height, (int)(fps * 1000 + 0.5));
+	}
+	else if ((mkdir(glob.out, 0755) != 0) && (errno != EEXIST)) {
+		printf("Cannot create %s\n", glob.out);
+		exit(1);
+	}
+
+	// the jitter of the vacuum columns is the same in every export
+	jitter_seed(1);
+
+	g_mutex_init(&glob.lock);
+	g_cond_init(&glob.done);
+	glob.window = 2 * threads;
+	glob.inflight = g_new0(struct job *, glob.window);
+	GThreadPool *pool = g_thread_pool_new(render_job, 0, threads, FALSE, 0);
+
+	long t0 = r[0].t;
+	long t = t0;
+	long end = r[n - 1].t;
+	int next = 0;				// next record to be applied
+	int status = 0, position = -1;
+	int moving = 1;
+	int frames = 0;
+	gint64 start = g_get_monotonic_time();
+
+	for (int i = 0; i < glob.numviews; i++)
+		glob.view[i].drive.tms = t0;
+
+	// after the last record, the drives are simulated until the reels stop
+	while (!glob.failed && ((t <= end) || (moving && (t <= end + MAX_TAIL)))) {
+		while ((next < n) && (r[next].t <= t)) {
+			status = r[next].status;
+			position = r[next].position;
+			next++;
+		}
+		moving = step(t, status, position);
+		long tnext = t + TIME_INTERVAL;
+
+		// the frames due before the next step show the drives as they are now
+		while (t0 + (long)(frames * 1000.0 / fps) < tnext) {
+			if (frames >= glob.window)
+				finish_job(frames - glob.window);
+			struct job *job = g_new0(struct job, 1);
+			job->index = frames;
+			memcpy(job->view, glob.view, sizeof(glob.view));
+			glob.inflight[frames % glob.window] = job;
+			g_thread_pool_push(pool, job, 0);
+			frames++;
+		}
+		t = tnext;
+	}
+	for (int i = frames > glob.window ? frames - glob.window : 0; i < frames; i++)
+		finish_job(i);
+	g_thread_pool_free(pool, FALSE, TRUE);
+	if ((glob.video != 0) && (fclose(glob.video) != 0) && !glob.failed) {
+		printf("Cannot write %s\n", glob.out);
+		glob.failed = 1;
+	}
+	if (glob.failed)
+		exit(1);
+
+	double seconds = (g_get_monotonic_time() - start) / 1e6;
+	printf("%d frames of %d x %d, %0.1f s of tape motion rendered in %0.1f s\n",
+		frames, glob.width, glob.height, frames / fps, seconds);
+	free_cache(glob.cache);
+	g_free(glob.inflight);
+	g_free(r);
+	return 0;
+}
@@ -0,0 +1,342 @@
+/*
+ * tqreplay.c
+ *
+ * Replays the TQ debug output of SimH on the magtape front panels, with the original timing
+ *
+ * usage: tqreplay [-ips n] [-speed f] [-trace file] logfile
+ *
+ * The log is written by SimH with
+ *
+ *   set tq debug=req;trc
+ *   set debug -t logfile
+ *
+ * The commands (cmd=), the I/O completions (tq_io_complete) and the responses (rsp=)
+ * of the driver are turned into the status changes which the driver writes
+ * to /tmp/tu56status, and written there at the times they happened. -trace file
+ * writes them as "msec status position" lines for tapexport instead.
+ *
+ * The times are taken from the wall clock (-t) if the log has it. Otherwise they are
+ * the simulated instructions divided by -ips n, or by the rate measured on the first
+ * read or write, because the driver delays the response by a known time.
+ *
+ * for the Raspberry Pi and other Linux systems
+ *
+ * Copyright 2019  rricharz
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "tape.h"
+
+// TMSCP opcodes which move the tape, as in pdp11_tq.c
+#define OP_CMP			32
+#define OP_RD			33
+#define OP_WR			34
+#define OP_WTM			36
+#define OP_POS			37
+
+#define MAX_PENDING		64		// commands waiting for their response
+
+enum { EV_CMD, EV_DONE, EV_RSP };
+
+struct event {
+	int kind;
+	double t;			// instructions, or seconds with the wall clock
+	int op;
+	int unit;
+	long pos;
+};
+
+struct record {
+	double t;
+	int index;			// keeps the order of records at the same time
+	int status;
+	long pos;
+};
+
+static struct event *event;
+static int numevents;
+static struct record *record;
+static int numrecords;
+
+static int parse_line(char *line, struct event *e, int *wall)
+// a TQ line of the debug log, "DBG(gtime)[ hh:mm:ss.mmm]> TQ REQ: ..."
+{
+	char *p = strstr(line, "DBG(");
+	if (p == 0)
+		return 0;
+	e->t = strtod(p + 4, &p);
+	char *q = strchr(p, '>');
+	if ((q == 0) || (strncmp(q, "> TQ", 4) != 0))
+		return 0;
+
+	int h, m;
+	double s;
+	if (sscanf(p, ")%d:%d:%lf", &h, &m, &s) == 3) {
+		e->t = 3600.0 * h + 60.0 * m + s;
+		*wall = 1;
+	}
+
+	char *c;
+	unsigned op;
+	if ((c = strstr(q, "cmd=")) != 0) {
+		if (sscanf(c, "cmd=%x", &op) != 1)
+			return 0;
+		e->kind = EV_CMD;
+		e->op = op & 0x3f;
+		e->unit = (p = strstr(c, "unit=")) ? atoi(p + 5) : 0;
+		e->pos = (p = strstr(c, "pos=")) ? strtol(p + 4, 0, 0) : -1;
+		return 1;
+	}
+	if ((c = strstr(q, "rsp=")) != 0) {
+		if (sscanf(c, "rsp=%x", &op) != 1)
+			return 0;
+		e->kind = EV_RSP;
+		e->op = op & 0x3f;
+		e->pos = (p = strstr(c, "pos=")) ? strtol(p + 4, 0, 10) : -1;
+		return 1;
+	}
+	if (strstr(q, "tq_io_complete") != 0) {
+		e->kind = EV_DONE;
+		return 1;
+	}
+	return 0;
+}
+
+static void read_log(char *name, int *wall)
+{
+	FILE *f = strcmp(name, "-") == 0 ? stdin : fopen(name, "r");
+	char line[1024];
+	int size = 0;
+	double day = 0.0;
+
+	if (f == 0) {
+		printf("Cannot open %s\n", name);
+		exit(1);
+	}
+	while (fgets(line, sizeof(line), f) != 0) {
+		struct event e;
+		if (!parse_line(line, &e, wall))
+			continue;
+		if (*wall) {
+			// the wall clock restarts at midnight
+			e.t += day;
+			if ((numevents > 0) && (e.t < event[numevents - 1].t - 43200.0)) {
+				day += 86400.0;
+				e.t += 86400.0;
+			}
+		}
+		if (numevents == size) {
+			size = size ? 2 * size : 1024;
+			event = realloc(event, size * sizeof(struct event));
+		}
+		event[numevents++] = e;
+	}
+	if (f != stdin)
+		fclose(f);
+}
+
+static int moving(int op)
+{
+	return (op == OP_POS) || (op == OP_RD) || (op == OP_WR) || (op == OP_CMP) || (op == OP_WTM);
+}
+
+static void add_record(double t, int status, long pos)
+{
+	static int size;
+
+	if (numrecords == size) {
+		size = size ? 2 * size : 1024;
+		record = realloc(record, size * sizeof(struct record));
+	}
+	record[numrecords].t = t;
+	record[numrecords].index = numrecords;
+	record[numrecords].status = status;
+	record[numrecords].pos = pos;
+	numrecords++;
+}
+
+static int compare_records(const void *a, const void *b)
+{
+	const struct record *r1 = a, *r2 = b;
+	if (r1->t != r2->t)
+		return r1->t < r2->t ? -1 : 1;
+	return r1->index - r2->index;
+}
+
+static double pair_events()
+// turn the events into the status changes of the driver, and return the
+// instructions per second measured on the first move, or 0
+{
+	struct event pending[MAX_PENDING];
+	double done[MAX_PENDING];
+	int numpending = 0;
+	double ips = 0.0;
+
+	for (int i = 0; i < numevents; i++) {
+		struct event *e = &event[i];
+		if (e->kind == EV_CMD) {
+			if (numpending == MAX_PENDING) {
+				printf("tqreplay: more than %d commands without response\n", MAX_PENDING);
+				exit(1);
+			}
+			done[numpending] = -1.0;
+			pending[numpending++] = *e;
+		}
+		else if (e->kind == EV_DONE) {
+			// the oldest move which has not completed, the line has no unit
+			for (int k = 0; k < numpending; k++)
+				if (moving(pending[k].op) && (done[k] < 0.0)) {
+					done[k] = e->t;
+					break;
+				}
+		}
+		else {
+			// the response has no unit, it belongs to the oldest command with its opcode
+			int k = 0;
+			while ((k < numpending) && (pending[k].op != e->op))
+				k++;
+			if (k == numpending)
+				continue;
+			struct event *c = &pending[k];
+			int status = TSTATE_ONLINE | (c->unit == 1 ? TSTATE_DRIVE1 : 0);
+			long pos = e->pos >= 0 ? e->pos : c->pos;
+			if (moving(c->op)) {
+				int bits = c->op == OP_POS ? TSTATE_SEEK :
+					(c->op == OP_WR) || (c->op == OP_WTM) ? TSTATE_WRITE : TSTATE_READ;
+				if ((c->pos >= 0) && (pos < c->pos))
+					bits |= TSTATE_BACKWARDS;
+				add_record(done[k] >= 0.0 ? done[k] : c->t, status | bits, pos);
+
+				// the driver delays the response by 0.1 msec per position and 200 msec
+				if ((ips == 0.0) && (done[k] >= 0.0) && (c->pos >= 0) && (e->t > done[k])) {
+					double ttime = 100.0 * labs(pos - c->pos) + 200000.0;
+					ips = (e->t - done[k]) / (ttime < 20000000.0 ? ttime : 20000000.0) * 1e6;
+				}
+			}
+			add_record(e->t, status, pos);
+			numpending--;
+			memmove(&pending[k], &pending[k + 1], (numpending - k) * sizeof(struct event));
+			memmove(&done[k], &done[k + 1], (numpending - k) * sizeof(double));
+		}
+	}
+	qsort(record, numrecords, sizeof(struct record), compare_records);
+	return ips;
+}
+
+static void setStatus(FILE *f, int status, long position)
+{
+	static unsigned long seq = 0;
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	fseek(f, 0L, SEEK_SET);
+	fprintf(f, "%c%ld %lld %lu\n", 32 + status, position,
+		(long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000, ++seq);
+	fflush(f);
+}
+
+static void wait_until(struct timespec *start, long t)
+// sleep until t msec after start
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	long elapsed = (ts.tv_sec - start->tv_sec) * 1000 + (ts.tv_nsec - start->tv_nsec) / 1000000;
+	if (t > elapsed)
+		usleep((t - elapsed) * 1000);
+}
+
+int main(int argc, char **argv)
+{
+	char *log = 0;
+	char *trace = 0;
+	double ips = 0.0;
+	double speed = 1.0;
+	int wall = 0;
+	int usage = 0;
+
+	for (int i = 1; i < argc; i++) {
+		if ((strcmp(argv[i], "-ips") == 0) && (i + 1 < argc))
+			ips = atof(argv[++i]);
+		else if ((strcmp(argv[i], "-speed") == 0) && (i + 1 < argc))
+			speed = atof(argv[++i]);
+		else if ((strcmp(argv[i], "-trace") == 0) && (i + 1 < argc))
+			trace = argv[++i];
+		else if ((log == 0) && ((argv[i][0] != '-') || (argv[i][1] == 0)))
+			log = argv[i];
+		else
+			usage = 1;
+	}
+	if (usage || (log == 0) || (speed <= 0.0)) {
+		printf("usage: tqreplay [-ips n] [-speed f] [-trace file] logfile\n");
+		exit(1);
+	}
+
+	read_log(log, &wall);
+	double measured = pair_events();
+	if (numrecords == 0) {
+		printf("tqreplay: no TQ commands and responses in %s\n", log);
+		exit(1);
+	}
+	// msec per unit of the log
+	double scale = 1000.0;
+	if (!wall) {
+		if (ips == 0.0) {
+			ips = measured;
+			if (ips != 0.0)
+				printf("tqreplay: %.0f instructions per second measured\n", ips);
+		}
+		if (ips == 0.0) {
+			printf("tqreplay: the log has no wall clock, give the instructions per second with -ips\n");
+			exit(1);
+		}
+		scale = 1000.0 / ips;
+	}
+	scale /= speed;
+	printf("tqreplay: %d events, %d status changes in %.1f seconds\n", numevents, numrecords,
+		(record[numrecords - 1].t - record[0].t) * scale / 1000.0);
+
+	FILE *out = fopen(trace ? trace : "/tmp/tu56status", "w");
+	if (out == 0) {
+		printf("Cannot open %s\n", trace ? trace : "/tmp/tu56status");
+		exit(1);
+	}
+	struct timespec start;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int i = 0; i < numrecords; i++) {
+		long t = (long)((record[i].t - record[0].t) * scale + 0.5);
+		if (trace)
+			fprintf(out, "%ld %d %ld\n", t, record[i].status, record[i].pos);
+		else {
+			wait_until(&start, t);
+			setStatus(out, record[i].status, record[i].pos);
+		}
+	}
+	if (!trace) {
+		wait_until(&start, (long)((record[numrecords - 1].t - record[0].t) * scale) + 1000);
+		setStatus(out, 0, 0);
+	}
+	fclose(out);
+	return 0;
+}